@@ -1,26 +1,148 @@
 #include "stdafx.h"
 #include "battle.h"
+#include "bench.h"
+#include "cache.h"
+#include "compare.h"
+#include "gamedata.h"
+#include "gauntlet.h"
+#include "grid.h"
+#include "ivsweep.h"
+#include "lineup.h"
+#include "matrix.h"
+#include "names.h"
+#include "platform.h"
 #include "pokemon.h"
+#include "policy.h"
+#include "random.h"
+#include "rules.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "stream.h"
+#include "trace.h"
 
 // The maximum number of movesets available for a mon (could have fewer)
 #define MAX_TOTAL_MOVES (MAX_SPECIAL_MOVES * MAX_BASIC_MOVES)
-// Gets the name of a move
-#define MOVE_NAME(_species, _type, _value) (moves[(_species)->_type[(_value)]].name)
-
-static void dumpStats(RepeatBattleResult *result) {
-	// Percentage won
-	int n = result->ntimes, pctWin = (100 * result->atkWins + (n >> 1)) / n;
-	printf("-- Battled %d times between:\n", n);
-	printPokemon(result->attacking);
-	puts("-- and");
-	printPokemon(result->defending);
-	printf("\n-- Attacker won %d/%d (%d%%)\n", result->atkWins, n, pctWin);
-	printf("   Average damage done by attacker: %.1f / %d\n", result->avgDefDamage,
-		getHP(result->defending) * DEF_HP_MULT);
-	printf("   Average damage done by defender: %.1f / %d\n", result->avgAtkDamage,
-		getHP(result->attacking) * ATK_HP_MULT);
-	printf("   Average time on battle clock   : %.1f s\n\n", result->avgTimeLeft * 0.001);
-}
+// Pokemon the defenders array first makes room for when a roster is read, doubled when full
+#define ROSTER_CHUNK 64
+// Side of the square tiles of matchups run together in matrix mode
+#define MATRIX_TILE 16
+// Gauntlets per task of a gym run
+#define GAUNTLET_CHUNK 1024
+// Longest shard file name
+#define SHARD_NAME_MAX 256
+// Matchups fought between writes of a sweep's cache file, so that a run that is stopped
+// carries on from the last write
+#define CHECKPOINT_TASKS 2048
+// Battles to run for each matchup
+#define NUM_BATTLES 50000
+// Seed used when none is given on the command line
+#define DEFAULT_SEED 20160807ULL
+// Sub-task of the seed that scores a policy search's winner on battles it was not picked on
+#define RESCORE_TASK 0xFFFFFFFFULL
+// Number of entries in STRATEGIES
+#define NUM_STRATEGIES 1
+
+// Change this one to determine dodging strategy (list several to compare them in one run)
+static const int STRATEGIES[NUM_STRATEGIES] = { STRAT_DODGE_CHARGE };
+// Names of the STRAT_x strategies
+static const char * const STRAT_NAMES[] = { "No dodging", "Dodge charge moves", "Dodge all" };
+// Index of the first attacker in the defenders array, right after the last defender
+static int attackerOffset = 0;
+
+// Command line settings
+typedef struct _Options {
+	// Seed for all random numbers; the same seed gives the same results on any thread count
+	uint64_t seed;
+	// Worker threads (0 = one per core)
+	int threads;
+	// Battles per matchup, or the most per matchup if precision is set
+	int battles;
+	// Stop each matchup once its confidence intervals are this tight (0 = always use battles)
+	double precision;
+	// Result cache file, or NULL to simulate everything
+	const char *cache;
+	// Game data image to load instead of the text files, or NULL
+	const char *image;
+	// Game data image to write from the text files, or NULL to run the simulation
+	const char *compile;
+	// File for the all vs all matrix (CSV if named .csv), or NULL to sweep one defender
+	const char *matrix;
+	// Baseline file to benchmark the engines against, or NULL to run the simulation
+	const char *bench;
+	// Rules file to battle by, or NULL for the rules in pokemon.h
+	const char *rules;
+	// Rule ranges to sweep the defender's matchups over (with fixed battle counts), or
+	// NULL to run them once
+	const char *grid;
+	// Table file written by the grid sweep
+	const char *table;
+	// Team and gym files (as attackers.txt) to run gauntlets of battles with, or NULL
+	const char *team;
+	const char *gym;
+	// File to write each matchup of the all vs all sweep to as soon as it is fought, or NULL
+	const char *stream;
+	// Part of the all vs all sweep to run, which is saved to a shard file named after the
+	// matrix instead of writing the matrix
+	int shard;
+	int numShards;
+	// Number of shard files to put together into the matrix, or 0 to fight the matchups
+	int merge;
+	// File for the best lineups of the attackers against the gym, or NULL
+	const char *lineup;
+	// Pokemon file (as attackers.txt) to sweep every IV combination of into the table, or NULL
+	const char *ivs;
+	// CPM indexes of the first and last level of the IV sweep
+	int minLevel;
+	int maxLevel;
+	// File for the best planner policy of each attacker against the defender, or NULL
+	const char *policy;
+	// Trace file to write the replayed battle to, or to decode if there is none, or NULL
+	const char *trace;
+	// Battle to replay: attacker row, defender moveset and battle number of the sweep, or -1
+	int replayAttacker;
+	int replayDefender;
+	int replayBattle;
+	// File for the ranking of the attackers against each moveset of the defender, fought with
+	// common random numbers, or NULL
+	const char *compare;
+} Options;
+
+// Every (attacker, defender moveset, strategy) combination to simulate
+typedef struct _Sweep {
+	// Attacking pokemon
+	const Pokemon *attackers;
+	int numAttackers;
+	// Defending pokemon
+	const Pokemon *defenders;
+	int numDefenders;
+	// Results, indexed by [strategy][defender][attacker], or NULL if they are only streamed
+	RepeatBattleResult *results;
+	// Cache key of each result
+	CacheKey *keys;
+	// Where each result is written as soon as it is fought, or NULL
+	ResultStream *stream;
+	// Results from earlier runs, or NULL to use the options' cache file (if any)
+	const ResultCache *cache;
+	// Only matchups whose content hashes to this shard of numShards are fought
+	int shard;
+	int numShards;
+	// Only takes results from the cache without fighting any
+	bool cachedOnly;
+	// Seed for the whole sweep
+	uint64_t seed;
+	// Battles per matchup, or the most per matchup if precision is set
+	int battles;
+	// Confidence interval half width for repeatFightAdaptive (0 = fixed battle count)
+	double precision;
+	// Side of the square tiles of (defender, attacker) matchups that run as neighbouring tasks
+	int tile;
+	// Task that task 0 of the current runTasks call stands for
+	int firstTask;
+#ifdef BATTLE_STATS
+	// Engine counters of each worker
+	BattleStats *stats;
+#endif
+} Sweep;
 
 // Creates a 10/10/10 level 20 (41 by our standards) pokemon of the given name
 static void createL20Poke(Pokemon *mon, const char *name, const char *basic,
@@ -34,9 +156,9 @@ static void createL20Poke(Pokemon *mon, const char *name, const char *basic,
 	mon->powerMove = getMoveName(special);
 }
 
-// Fills in all possible defenders (movesets) in the defenders array
-static void generateAllDefenders() {
-	Pokemon *mon = &defenders[0];
+// Fills in all possible defenders (movesets) of every species, returning how many there are
+static int generateAllDefenders(Pokemon *mon) {
+	const Pokemon *first = mon;
 	int bm, sm;
 	for (int i = 0; i < NUM_SPECIES; i++)
 		for (int j = 0; j < MAX_TOTAL_MOVES; j++) {
@@ -57,58 +179,69 @@ static void generateAllDefenders() {
 				mon++;
 			}
 		}
+	return (int)(mon - first);
 }
 
-// Fills in all possible movesets for one defender at the specified location in the defenders
-// array
-static void generateOneDefender(const char *name, int offset) {
-	int bm, sm, species = getSpeciesName(name);
-	Species *spec = &specData[species];
-	Pokemon *mon = &defenders[offset];
-	for (int j = 0; j < MAX_TOTAL_MOVES; j++) {
-		// Set up species, level 20, 10/10/10
-		bm = spec->basic[j / MAX_SPECIAL_MOVES];
-		sm = spec->special[j % MAX_SPECIAL_MOVES];
-		// Do not generate invalid defenders
-		if (bm > 0 && sm > 0) {
-			mon->species = species;
-			mon->level = 41;
-			mon->ivAttack = 10;
-			mon->ivDefense = 10;
-			mon->ivHP = 10;
-			// Pick the moves
-			mon->basicMove = bm;
-			mon->powerMove = sm;
-			mon++;
-		}
+// Reads stored pokemon from an open file into an array, using createL20Poke, stopping at the
+// end, at the first line that is not one or after maxCount of them
+static int readMons(FILE *fh, Pokemon *mons, int maxCount) {
+	char name[BUFFER_SIZE], basicMove[BUFFER_SIZE], chargeMove[BUFFER_SIZE];
+	Pokemon *def = mons;
+	int i = 0;
+	// Read in mon name and moves
+	while (i < maxCount && 3 == fscanf_s(fh, "%[^\t] %[^\t] %[^\r\n] ", name, BUFFER_SIZE,
+			basicMove, BUFFER_SIZE, chargeMove, BUFFER_SIZE)) {
+		createL20Poke(def++, name, basicMove, chargeMove);
+		i++;
+#if 1
+		printf("SAVED %s [%s / %s]\n", name, basicMove, chargeMove);
+#endif
 	}
+	// # actually read
+	return i;
 }
 
-// Reads stored pokemon into the defenders array, using createL20Poke
-static int readInMons(const char *filename, int offset, int maxCount) {
+// Reads stored pokemon into an array, using createL20Poke
+static int readInMons(const char *filename, Pokemon *mons, int maxCount) {
 	FILE *fh;
 	int i = 0;
 	if (fopen_s(&fh, filename, "r") != 0 || fh == NULL)
 		// Uh oh
 		puts("Failed to load saved pokemon list!\r");
 	else {
-		char name[BUFFER_SIZE], basicMove[BUFFER_SIZE], chargeMove[BUFFER_SIZE];
-		Pokemon *def = &defenders[offset];
-		for (; i < maxCount && !feof(fh); i++)
-			// Read in mon name and moves
-			if (3 == fscanf_s(fh, "%[^\t] %[^\t] %[^\n] ", name, BUFFER_SIZE, basicMove,
-					BUFFER_SIZE, chargeMove, BUFFER_SIZE)) {
-				createL20Poke(def++, name, basicMove, chargeMove);
-#if 1
-				printf("SAVED %s [%s / %s]\n", name, basicMove, chargeMove);
-#endif
-			}
+		i = readMons(fh, mons, maxCount);
 		fclose(fh);
 	}
-	// # actually read
 	return i;
 }
 
+// Reads a whole roster file onto the defenders array from index first on, growing the array
+// to fit it; returns the number of pokemon read, or -1 if the array could not be grown
+static int readRoster(const char *filename, int first) {
+	FILE *fh;
+	int count = 0, room = 0;
+	if (fopen_s(&fh, filename, "r") != 0 || fh == NULL)
+		// Uh oh
+		puts("Failed to load saved pokemon list!\r");
+	else {
+		bool full;
+		do {
+			Pokemon *grown;
+			room = (room > 0) ? room * 2 : ROSTER_CHUNK;
+			grown = (Pokemon *)realloc(defenders, sizeof(Pokemon) * (size_t)(first + room));
+			full = grown != NULL;
+			if (full) {
+				defenders = grown;
+				count += readMons(fh, &defenders[first + count], room - count);
+				full = count == room;
+			} else
+				count = -1;
+		} while (full);
+		fclose(fh);
+	}
+	return count;
+}
+
 // Prompts the user for the base pokemon to use (finds first entry in defenders with name
 // matching this one, or -1 if none were found)
 static int getBasePokemon() {
@@ -123,14 +256,13 @@ static int getBasePokemon() {
 	// Strip the newline
 	if (len > 0) {
 		name[len - 1] = '\0';
-		// Retrieve species
-		species = getSpeciesName(name);
+		// Retrieve species, allowing a partial or misspelled name
+		species = matchName(name, true);
 		if (species >= 0) {
 			// Found it
-#if 0
-			printf("Matched species: %s (index %d)\n", specData[species].name, species);
-#endif
-			for (int i = 0; i < MAX_DEFENDERS && base < 0; i++)
+			if (_strcmpi(name, specData[species].name) != 0)
+				printf("Matched species: %s\n", specData[species].name);
+			for (int i = 0; i < attackerOffset && base < 0; i++)
 				if (defenders[i].species == species)
 					base = i;
 #ifdef _DEBUG
@@ -141,96 +273,1000 @@ static int getBasePokemon() {
 	return base;
 }
 
-// Outputs the battle results (expecting 36) in a matrix
-static void printMatrix(RepeatBattleResult *result) {
-	Species *atkSpec = &specData[result->attacking->species], *defSpec = &specData[
-		result->defending->species];
-	// Generate the matrix
-	puts("\nKEY:");
-	for (int i = 0; i < MAX_TOTAL_MOVES; i++) {
-		int fast = i / MAX_SPECIAL_MOVES, charge = i % MAX_SPECIAL_MOVES;
-		// Legend to moves
-		printf("%1d%1d = %s / %s,  %s / %s\n", fast, charge, MOVE_NAME(atkSpec, basic, fast),
-			MOVE_NAME(atkSpec, special, charge), MOVE_NAME(defSpec, basic, fast),
-			MOVE_NAME(defSpec, special, charge));
-	}
-	puts("\nTOTAL:\nAT 00    01    02    10    11    12    DEFENDER");
-	for (int i = 0; i < MAX_TOTAL_MOVES; i++) {
-		double rt = 0.0, value;
-		printf("%1d%1d ", i / MAX_SPECIAL_MOVES, i % MAX_SPECIAL_MOVES);
-		for (int j = 0; j < MAX_TOTAL_MOVES; j++) {
-			// Show average attack damage to 1 decimal
-			value = result[MAX_TOTAL_MOVES * i + j].avgAtkDamage;
-			printf("%5.1f ", value);
-			rt += value;
-		}
-		// Row average
-		printf("%5.1f\n", rt / (double)MAX_TOTAL_MOVES);
-	}
-	// Column averages
-	printf("-- ");
-	for (int i = 0; i < MAX_TOTAL_MOVES; i++) {
-		double ct = 0.0;
-		for (int j = 0; j < MAX_TOTAL_MOVES; j++)
-			ct += result[MAX_TOTAL_MOVES * j + i].avgAtkDamage;
-		// Show average attack damage to 1 decimal
-		printf("%5.1f ", ct / (double)MAX_TOTAL_MOVES);
-	}
-	puts("\n");
-}
-
-int main() {
-	RepeatBattleResult result[150];
-	Timeline atkTL, defTL;
-	// Read in all data and build timeline objects
-	initTimeline(&atkTL);
-	initTimeline(&defTL);
-	if (readMovesBasic() && readMovesPower() && readSpecies() && atkTL.data != NULL &&
-			defTL.data != NULL) {
-		// Create top mons
-		int base, attackers;
-		readInMons("defenders.txt", 0, 150);
-		attackers = readInMons("attackers.txt", 200, 150);
-		base = getBasePokemon();
-		if (base >= 0 && attackers > 0) {
-			// Send elite attackers against the defender
-			for (int i = 0; i < MAX_TOTAL_MOVES; i++) {
-				const Pokemon *defense = &defenders[i + base];
-				double td = 0.0, total = (double)attackers;
-				unsigned long long totalWins = 0ULL;
-				printf("%s has %s / %s...\n", specData[defense->species].name,
-					moves[defense->basicMove].name, moves[defense->powerMove].name);
-				// This loop can be parallelized, and does it well!
-#ifndef _DEBUG
-#pragma loop(hint_parallel(8))
-#pragma loop(ivdep)
-#endif
-				for (int j = 0; j < attackers; j++) {
-					// Hit against this moveset
+// Counts the movesets of the base pokemon, which are the entries from base on with its species
+// (at most MAX_TOTAL_MOVES, stopping at one whose basic move is not known)
+static int countMovesets(int base) {
+	int count = 0;
+	while (count < MAX_TOTAL_MOVES && base + count < attackerOffset &&
+			defenders[base + count].species == defenders[base].species &&
+			defenders[base + count].basicMove > 0)
+		count++;
+	return count;
+}
+
+// Gets the result index ([strategy][defender][attacker]) of a task; tasks go through each
+// strategy in bands of tile defenders, and through each band in tiles of tile attackers
+static int sweepIndex(const Sweep *sweep, int task) {
+	int na = sweep->numAttackers, nd = sweep->numDefenders, tile = sweep->tile;
+	int cells = na * nd, strategy = task / cells, offset = task % cells;
+	// Band of defenders, which may be short at the end
+	int band = offset / (tile * na), rows = (nd - band * tile < tile) ? nd - band * tile : tile;
+	// Tile of attackers in the band, which may be narrow at the end
+	int col, cols;
+	offset -= band * tile * na;
+	col = offset / (tile * rows);
+	cols = (na - col * tile < tile) ? na - col * tile : tile;
+	offset -= col * tile * rows;
+	return (strategy * nd + band * tile + offset / cols) * na + col * tile + offset % cols;
+}
+
+// Runs one (attacker, defender moveset, strategy) matchup of the sweep
+static void sweepTask(void *context, int task, int worker) {
+	Sweep *sweep = (Sweep *)context;
+	int na = sweep->numAttackers, nd = sweep->numDefenders, idx = sweepIndex(sweep,
+		sweep->firstTask + task);
+	const Pokemon *attack = &sweep->attackers[idx % na], *defense = &sweep->defenders[(idx /
+		na) % nd];
+	int strategy = STRATEGIES[idx / (na * nd)];
+	RepeatBattleResult fought, *result = (sweep->results != NULL) ? &sweep->results[idx] :
+		&fought;
+	CacheKey found, *key = (sweep->keys != NULL) ? &sweep->keys[idx] : &found;
+	MatchupContext ctx;
+	uint64_t seed, precision;
+	bool inShard, cached;
+	(void)worker;
+	initMatchup(&ctx, attack, defense);
+	matchupKey(key, &ctx, strategy);
+	// Seeded by content, so a matchup gets the same battles wherever it is in the roster
+	seed = deriveSeed(sweep->seed, key->hash[0]);
+	// Sharded by content too, so every process agrees on which shard has a matchup (by the
+	// second hash, as the first always has its low bit set)
+	inShard = key->hash[1] % (uint64_t)sweep->numShards == (uint64_t)sweep->shard;
+	memcpy(&precision, &sweep->precision, sizeof(precision));
+	addKey(key, sweep->seed);
+	addKey(key, (uint64_t)sweep->battles);
+	addKey(key, precision);
+	// Fought in an earlier run?
+	cached = inShard && sweep->cache != NULL && findResult(sweep->cache, key, result);
+	result->attacking = attack;
+	result->defending = defense;
+	if (!inShard || (sweep->cachedOnly && !cached))
+		// Left to another process, or missing from the shards being merged
+		result->ntimes = -1;
+	else if (!cached) {
 #ifdef _DEBUG
-					printf("%24s VS %24s...\r", specData[defenders[200 + j].species].name,
-						specData[defense->species].name);
-					fflush(stdout);
+		printf("%24s VS %24s...\r", specData[attack->species].name,
+			specData[defense->species].name);
+		fflush(stdout);
+#endif
+		if (sweep->precision > 0.0)
+			repeatFightAdaptive(result, attack, defense, sweep->precision, sweep->battles,
+				strategy, seed);
+		else
+			repeatFight(result, attack, defense, sweep->battles, strategy, seed);
+	}
+	if (sweep->stream != NULL && result->ntimes >= 0)
+		pushResult(sweep->stream, strategy, result);
+#ifdef BATTLE_STATS
+	if (sweep->stats != NULL)
+		collectStats(&sweep->stats[worker]);
 #endif
-					// Change this one to determine dodging strategy
-					repeatFight(&result[j], &defenders[200 + j], defense, 50000,
-						STRAT_DODGE_CHARGE);
+}
+
+// Reads "-name value" option pairs, returning false if any are not recognized
+static bool parseOptions(Options *opt, int argc, char *argv[]) {
+	bool ok = true;
+	opt->seed = DEFAULT_SEED;
+	opt->threads = 0;
+	opt->battles = NUM_BATTLES;
+	opt->precision = 0.0;
+	opt->cache = NULL;
+	opt->image = NULL;
+	opt->compile = NULL;
+	opt->matrix = NULL;
+	opt->bench = NULL;
+	opt->rules = NULL;
+	opt->grid = NULL;
+	opt->table = NULL;
+	opt->team = NULL;
+	opt->gym = NULL;
+	opt->policy = NULL;
+	opt->lineup = NULL;
+	opt->ivs = NULL;
+	// Level 20 to 40
+	opt->minLevel = 39;
+	opt->maxLevel = NUM_LEVELS - 1;
+	opt->stream = NULL;
+	opt->shard = 0;
+	opt->numShards = 1;
+	opt->merge = 0;
+	opt->trace = NULL;
+	opt->replayAttacker = -1;
+	opt->replayDefender = -1;
+	opt->replayBattle = -1;
+	opt->compare = NULL;
+	for (int i = 1; i < argc && ok; i += 2) {
+		const char *name = argv[i], *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if (value == NULL)
+			ok = false;
+		else if (strcmp(name, "-seed") == 0)
+			opt->seed = strtoull(value, NULL, 0);
+		else if (strcmp(name, "-threads") == 0)
+			opt->threads = atoi(value);
+		else if (strcmp(name, "-battles") == 0)
+			ok = (opt->battles = atoi(value)) > 0;
+		else if (strcmp(name, "-precision") == 0)
+			// For example 0.01 = win rate and damage within +/- 1% at 95% confidence
+			ok = (opt->precision = atof(value)) >= 0.0;
+		else if (strcmp(name, "-cache") == 0)
+			opt->cache = value;
+		else if (strcmp(name, "-image") == 0)
+			opt->image = value;
+		else if (strcmp(name, "-compile") == 0)
+			opt->compile = value;
+		else if (strcmp(name, "-matrix") == 0)
+			opt->matrix = value;
+		else if (strcmp(name, "-bench") == 0)
+			opt->bench = value;
+		else if (strcmp(name, "-rules") == 0)
+			opt->rules = value;
+		else if (strcmp(name, "-grid") == 0)
+			opt->grid = value;
+		else if (strcmp(name, "-table") == 0)
+			opt->table = value;
+		else if (strcmp(name, "-team") == 0)
+			opt->team = value;
+		else if (strcmp(name, "-gym") == 0)
+			opt->gym = value;
+		else if (strcmp(name, "-policy") == 0)
+			opt->policy = value;
+		else if (strcmp(name, "-lineup") == 0)
+			opt->lineup = value;
+		else if (strcmp(name, "-ivs") == 0)
+			opt->ivs = value;
+		else if (strcmp(name, "-levels") == 0) {
+			// Poke Go levels as from-to, in steps of 0.5
+			char *end;
+			opt->minLevel = (int)(2.0 * strtod(value, &end) + 0.5) - 1;
+			ok = *end == '-';
+			if (ok)
+				opt->maxLevel = (int)(2.0 * strtod(end + 1, NULL) + 0.5) - 1;
+			ok = ok && opt->minLevel >= 1 && opt->minLevel <= opt->maxLevel && opt->maxLevel <
+				NUM_LEVELS;
+		}
+		else if (strcmp(name, "-stream") == 0)
+			opt->stream = value;
+		else if (strcmp(name, "-shard") == 0) {
+			// Shard index and count as i/n, starting from 0/n
+			char *end;
+			opt->shard = (int)strtol(value, &end, 10);
+			ok = *end == '/' && (opt->numShards = atoi(end + 1)) > 0 && opt->shard >= 0 &&
+				opt->shard < opt->numShards;
+		} else if (strcmp(name, "-merge") == 0)
+			ok = (opt->merge = atoi(value)) > 0;
+		else if (strcmp(name, "-compare") == 0)
+			opt->compare = value;
+		else if (strcmp(name, "-trace") == 0)
+			opt->trace = value;
+		else if (strcmp(name, "-replay") == 0) {
+			// Attacker, defender moveset and battle as a/d/b, starting from 0/0/0
+			char *end;
+			opt->replayAttacker = (int)strtol(value, &end, 10);
+			ok = *end == '/';
+			if (ok)
+				opt->replayDefender = (int)strtol(end + 1, &end, 10);
+			ok = ok && *end == '/';
+			if (ok)
+				opt->replayBattle = (int)strtol(end + 1, &end, 10);
+			ok = ok && *end == '\0' && opt->replayAttacker >= 0 && opt->replayDefender >= 0 &&
+				opt->replayDefender < MAX_TOTAL_MOVES && opt->replayBattle >= 0;
+		} else
+			ok = false;
+	}
+	// Shard files are named after the matrix, and a shard cannot also be a merge
+	ok = ok && ((opt->numShards == 1 && opt->merge == 0) || (opt->matrix != NULL &&
+		(opt->numShards == 1 || opt->merge == 0)));
+	// A grid sweep needs somewhere to put its table
+	ok = ok && (opt->table == NULL) == (opt->grid == NULL && opt->ivs == NULL) &&
+		(opt->grid == NULL || opt->ivs == NULL) && (opt->gym == NULL) ==
+		(opt->team == NULL && opt->lineup == NULL) && (opt->team == NULL || opt->lineup == NULL);
+	// A replay is written to a trace file
+	ok = ok && (opt->replayBattle < 0 || opt->trace != NULL);
+	if (!ok)
+		puts("Usage: PokemonGoSim [-seed n] [-threads n] [-battles n] "
+			"[-precision p] [-cache file] [-image file | -compile file] "
+			"[[-matrix file [-shard i/n | -merge n]] [-stream file] | -bench baseline | "
+			"[-grid ranges | -ivs file [-levels from-to]] -table file | "
+			"[-team file | -lineup file] -gym file | -policy file | -compare file | "
+			"[-replay attacker/moveset/battle] -trace file] [-rules file]");
+	return ok;
+}
+
+// Reads the game data and both rosters from an image or the text files, writing an image if
+// asked to; returns the number of attackers, or -1 if the data could not be read
+static int readData(const Options *opt) {
+	int attackers = -1;
+	if (opt->image != NULL) {
+		if (!loadImage(opt->image, &defenders, &attackerOffset, &attackers)) {
+			printf("Failed to load game data image %s!\n", opt->image);
+			attackers = -1;
+		}
+	} else if (readMovesBasic() && readMovesPower() && readSpecies()) {
+		// Attackers go right after however many defenders there are
+		attackerOffset = readRoster("defenders.txt", 0);
+		if (attackerOffset >= 0)
+			attackers = readRoster("attackers.txt", attackerOffset);
+		if (attackers >= 0 && opt->compile != NULL && !writeImage(opt->compile, &defenders[0],
+				attackerOffset, &defenders[attackerOffset], attackers)) {
+			printf("Failed to write game data image %s!\n", opt->compile);
+			attackers = -1;
+		}
+	}
+	return attackers;
+}
+
+// Names the file that holds one shard of the all vs all sweep after the matrix it is part of
+static const char * shardName(char *name, size_t size, const char *matrix, int shard,
+		int numShards) {
+	snprintf(name, size, "%s.shard-%d-of-%d", matrix, shard, numShards);
+	return name;
+}
+
+// Runs every matchup of a sweep on the options' threads, reusing and updating the
+// result cache if there is one; returns false if the sweep could not be run
+static bool runSweep(Sweep *sweep, const Options *opt) {
+	ResultCache cache;
+	char shardFile[SHARD_NAME_MAX];
+	// A shard keeps its results in its own file, so a shard that stopped early can carry on
+	const char *cacheName = (sweep->numShards > 1) ? shardName(shardFile, sizeof(shardFile),
+		opt->matrix, sweep->shard, sweep->numShards) : opt->cache;
+	int tasks = NUM_STRATEGIES * sweep->numDefenders * sweep->numAttackers, run = 0, chunk;
+	bool keep, own = false, ok = false;
+#ifdef BATTLE_STATS
+	int workers = (opt->threads > 0) ? opt->threads : defaultWorkers();
+	double start = getSeconds();
+	// Counts are left out if there is no memory for them
+	sweep->stats = (BattleStats *)calloc((size_t)workers, sizeof(BattleStats));
+#endif
+	sweep->seed = opt->seed;
+	sweep->battles = opt->battles;
+	sweep->precision = opt->precision;
+	if (sweep->cache == NULL && cacheName != NULL && initCache(&cache)) {
+		if (!readCache(&cache, cacheName)) {
+			printf("Cache %s is not valid, starting a new one\n", cacheName);
+			destroyCache(&cache);
+			initCache(&cache);
+		}
+		sweep->cache = &cache;
+		own = true;
+	}
+	// Streamed results are only kept if they are to be cached or written as a matrix too
+	keep = sweep->stream == NULL || sweep->cache != NULL || opt->matrix != NULL;
+	sweep->results = NULL;
+	sweep->keys = NULL;
+	if (keep) {
+		sweep->results = (RepeatBattleResult *)malloc(sizeof(RepeatBattleResult) *
+			(size_t)tasks);
+		sweep->keys = (CacheKey *)malloc(sizeof(CacheKey) * (size_t)tasks);
+	}
+	ok = !keep || (sweep->results != NULL && sweep->keys != NULL);
+	// A sweep with its own cache file runs in chunks and writes the file after each one
+	chunk = own ? CHECKPOINT_TASKS : tasks;
+	for (int first = 0; first < tasks && ok; first += chunk) {
+		int count = (tasks - first < chunk) ? tasks - first : chunk;
+		size_t added = own ? cache.added : 0U;
+		sweep->firstTask = first;
+		ok = runTasks(sweepTask, sweep, count, opt->threads);
+		if (ok && own) {
+			// Save anything new for next time, leaving out matchups of other shards (the
+			// results are indexed by matchup, not by task)
+			for (int t = first; t < first + count; t++) {
+				int idx = sweepIndex(sweep, t);
+				if (sweep->results[idx].ntimes >= 0) {
+					addResult(&cache, &sweep->keys[idx], &sweep->results[idx]);
+					run++;
 				}
-				for (int j = 0; j < attackers; j++) {
-					// Summary stats
-					td += result[j].avgAtkDamage;
-					totalWins += (unsigned long long)result[j].atkWins;
+			}
+			// The last chunk is written below
+			if (first + count < tasks && cache.added > added && !writeCache(&cache, cacheName))
+				printf("Could not write cache %s\n", cacheName);
+		}
+	}
+	if (ok) {
+		if (own) {
+			printf("%d of %d matchups were cached\n", run - (int)cache.added, run);
+			// Every shard leaves its file behind, even if it had nothing new to fight
+			if ((cache.added > 0U || sweep->numShards > 1) && !writeCache(&cache, cacheName)) {
+				printf("Could not write cache %s\n", cacheName);
+				ok = sweep->numShards == 1;
+			} else
+				ok = true;
+		} else
+			ok = true;
+#ifdef BATTLE_STATS
+		if (sweep->stats != NULL) {
+			for (int i = 1; i < workers; i++)
+				addStats(&sweep->stats[0], &sweep->stats[i]);
+			printStats(&sweep->stats[0], getSeconds() - start);
+		}
+#endif
+	}
+	if (own)
+		destroyCache(&cache);
+	sweep->cache = NULL;
+	free(sweep->keys);
+	sweep->keys = NULL;
+#ifdef BATTLE_STATS
+	free(sweep->stats);
+	sweep->stats = NULL;
+#endif
+	return ok;
+}
+
+// Prints the summary of each defender moveset of a sweep
+static void printSweep(const Sweep *sweep, const Options *opt) {
+	int attackers = sweep->numAttackers;
+	for (int s = 0; s < NUM_STRATEGIES; s++) {
+#if NUM_STRATEGIES > 1
+		printf("\n-- %s --\n", STRAT_NAMES[STRATEGIES[s]]);
+#endif
+		for (int i = 0; i < sweep->numDefenders; i++) {
+			const Pokemon *defense = &sweep->defenders[i];
+			const RepeatBattleResult *result = &sweep->results[(s * sweep->numDefenders + i) *
+				attackers];
+			double td = 0.0, winRate = 0.0, total = 0.0;
+			printf("%s has %s / %s...\n", specData[defense->species].name,
+				moves[defense->basicMove].name, moves[defense->powerMove].name);
+			for (int j = 0; j < attackers; j++) {
+				// Summary stats
+				td += result[j].avgAtkDamage;
+				// Average the rates, since matchups may run different battle counts
+				winRate += result[j].winRate;
+				total += (double)result[j].ntimes;
+			}
+			printf("\nAverage damage done to attacker: %.1f (%.2f%% loss rate)\n",
+				td / (double)attackers, 100.0 * winRate / (double)attackers);
+			if (opt->precision > 0.0)
+				printf("Battles fought: %.0f\n", total);
+		}
+	}
+}
+
+// Every matchup of a sweep under the rules of every point of a grid
+typedef struct _GridSweep {
+	// Matchups, seed and battle count; results are indexed by [point][strategy][defender]
+	// [attacker]
+	Sweep sweep;
+	// Grid swept, and the rules of each point
+	const RuleGrid *grid;
+	const Rules *rules;
+} GridSweep;
+
+// Runs one (attacker, defender moveset, strategy) matchup of a grid sweep at every point
+static void gridTask(void *context, int task, int worker) {
+	GridSweep *gs = (GridSweep *)context;
+	const Sweep *sweep = &gs->sweep;
+	int na = sweep->numAttackers, nd = sweep->numDefenders, matchups = NUM_STRATEGIES * na *
+		nd;
+	const Pokemon *attack = &sweep->attackers[task % na], *defense = &sweep->defenders[(task /
+		na) % nd];
+	int strategy = STRATEGIES[task / (na * nd)];
+	MatchupContext ctx;
+	CacheKey key;
+	uint64_t seed;
+	(void)worker;
+	// Every point fights the same battles as a plain sweep, so that only the rules move the
+	// results
+	initMatchup(&ctx, attack, defense);
+	matchupKey(&key, &ctx, strategy);
+	seed = deriveSeed(sweep->seed, key.hash[0]);
+	for (int p = 0; p < gs->grid->numPoints; p++) {
+		const Rules *rules = &gs->rules[p];
+		// Points that only change the battle loop share the damage tables
+		if (sameTableRules(ctx.rules, rules))
+			ctx.rules = rules;
+		else
+			initMatchupRules(&ctx, attack, defense, rules);
+		repeatFightContext(&sweep->results[p * matchups + task], &ctx, sweep->battles,
+			strategy, seed);
+	}
+}
+
+// Runs the elite attackers against every moveset of the defender at every point of the rule
+// grid and writes one table; returns false if it could not be run or written
+static bool runGrid(const Options *opt, int attackers) {
+	GridSweep gs;
+	RuleGrid grid;
+	Rules *rules = NULL;
+	int base = -1, movesets = 0, matchups = 0;
+	bool ok = false;
+	gs.sweep.results = NULL;
+	if (readRuleGrid(&grid, opt->grid) && attackers > 0)
+		base = getBasePokemon();
+	if (base >= 0) {
+		movesets = countMovesets(base);
+		matchups = NUM_STRATEGIES * movesets * attackers;
+		rules = (Rules *)malloc(sizeof(Rules) * (size_t)grid.numPoints);
+		gs.sweep.results = (RepeatBattleResult *)malloc(sizeof(RepeatBattleResult) *
+			(size_t)grid.numPoints * (size_t)matchups);
+	}
+	if (rules != NULL && gs.sweep.results != NULL) {
+		for (int p = 0; p < grid.numPoints; p++)
+			gridRules(&grid, p, &rules[p]);
+		gs.sweep.attackers = &defenders[attackerOffset];
+		gs.sweep.numAttackers = attackers;
+		gs.sweep.defenders = &defenders[base];
+		gs.sweep.numDefenders = movesets;
+		gs.sweep.seed = opt->seed;
+		gs.sweep.battles = opt->battles;
+		gs.grid = &grid;
+		gs.rules = rules;
+		printf("Running %d matchups at %d grid points...\n", matchups, grid.numPoints);
+		if (runTasks(gridTask, &gs, matchups, opt->threads)) {
+			GridTable table;
+			table.grid = &grid;
+			table.results = gs.sweep.results;
+			table.strategies = STRATEGIES;
+			table.numStrategies = NUM_STRATEGIES;
+			table.attackers = gs.sweep.attackers;
+			table.numAttackers = attackers;
+			table.numDefenders = movesets;
+			ok = writeGridTable(&table, opt->table);
+			if (ok)
+				printf("Wrote %d grid points to %s\n", grid.numPoints, opt->table);
+			else
+				printf("Could not write table %s\n", opt->table);
+		}
+	}
+	free(gs.sweep.results);
+	free(rules);
+	return ok;
+}
+
+// Gauntlets of one team against one gym, split into tasks of GAUNTLET_CHUNK
+typedef struct _GymRun {
+	// Matchups of the team against the gym
+	const Gauntlet *gauntlet;
+	// Result of each task
+	GauntletResult *parts;
+	// Gauntlets in all, strategy and seed
+	int n;
+	int strategy;
+	uint64_t seed;
+} GymRun;
+
+// Runs one chunk of the gauntlets of a gym run
+static void gymTask(void *context, int task, int worker) {
+	GymRun *run = (GymRun *)context;
+	int first = task * GAUNTLET_CHUNK, count = run->n - first;
+	(void)worker;
+	if (count > GAUNTLET_CHUNK)
+		count = GAUNTLET_CHUNK;
+	repeatGauntlet(&run->parts[task], run->gauntlet, first, count, run->strategy, run->seed);
+}
+
+// Runs all the gauntlets of a gym run and adds them up; returns false if they could not be run
+static bool runGauntlets(GymRun *run, int tasks, int threads, GauntletResult *result) {
+	bool ok = runTasks(gymTask, run, tasks, threads);
+	memset(result, 0, sizeof(GauntletResult));
+	for (int t = 0; t < tasks && ok; t++)
+		addGauntlets(result, &run->parts[t]);
+	return ok;
+}
+
+// Reports true if every pokemon read by readInMons has a known species and moves
+static bool validMons(const Pokemon *mons, int count) {
+	bool ok = count > 0;
+	for (int i = 0; i < count && ok; i++)
+		ok = mons[i].species >= 0 && mons[i].basicMove >= 0 && mons[i].powerMove >= 0;
+	return ok;
+}
+
+// Runs the team through the gym with every strategy and prints the win rate and losses;
+// returns false if the team or gym could not be read
+static bool runGym(const Options *opt) {
+	Pokemon team[MAX_TEAM], gym[MAX_GYM];
+	int teamSize = readInMons(opt->team, team, MAX_TEAM), gymSize = readInMons(opt->gym, gym,
+		MAX_GYM), tasks = (opt->battles + GAUNTLET_CHUNK - 1) / GAUNTLET_CHUNK;
+	Gauntlet *gauntlet = (Gauntlet *)malloc(sizeof(Gauntlet));
+	GymRun run;
+	bool ok = validMons(team, teamSize) && validMons(gym, gymSize);
+	run.parts = (GauntletResult *)malloc(sizeof(GauntletResult) * (size_t)tasks);
+	if (!ok)
+		puts("Team or gym has an unknown pokemon or move");
+	else if (gauntlet != NULL && run.parts != NULL) {
+		initGauntlet(gauntlet, team, teamSize, gym, gymSize);
+		run.gauntlet = gauntlet;
+		run.n = opt->battles;
+		run.seed = opt->seed;
+		for (int s = 0; s < NUM_STRATEGIES && ok; s++) {
+			GauntletResult result;
+			double start = getSeconds(), seconds;
+			run.strategy = STRATEGIES[s];
+			ok = runGauntlets(&run, tasks, opt->threads, &result);
+			seconds = getSeconds() - start;
+			printf("\n-- %s: %d attackers vs %d defenders --\n", STRAT_NAMES[STRATEGIES[s]],
+				teamSize, gymSize);
+			printf("Team won %d/%d (%.2f%% +/- %.2f%%)\n", result.wins, result.ntimes,
+				100.0 * result.winRate, 100.0 * result.winError);
+			printf("Average attackers lost: %.2f, defenders beaten: %.2f\n", result.avgLosses,
+				result.avgBeaten);
+			printf("%.0f gauntlets per minute\n", 60.0 * (double)result.ntimes / seconds);
+		}
+	} else
+		ok = false;
+	free(run.parts);
+	free(gauntlet);
+	return ok;
+}
+
+// Reports true if one team did better in its gauntlets than another: won more, or else lost
+// fewer attackers
+static bool betterGauntlet(const GauntletResult *a, const GauntletResult *b) {
+	return a->winRate > b->winRate || (a->winRate == b->winRate && a->avgLosses <
+		b->avgLosses);
+}
+
+// Writes the team of a lineup, best first, as CSV lines after the strategy and rank
+static bool writeLineup(FILE *fh, int strategy, int rank, const Lineup *lineup,
+		const GauntletResult *result) {
+	bool ok = true;
+	for (int i = 0; i < lineup->size && ok; i++) {
+		const Pokemon *mon = &defenders[attackerOffset + lineup->order[i]];
+		ok = fprintf(fh, "%d,%d,%d,%s,%s,%s,%.5f,%.5f,%.3f,%.3f,%.3f,%d,%.0f\n", strategy, rank,
+			i + 1, specData[mon->species].name, moves[mon->basicMove].name,
+			moves[mon->powerMove].name, result->winRate, result->winError, result->avgLosses,
+			result->avgBeaten, lineup->beaten, lineup->losses, lineup->time) > 0;
+	}
+	return ok;
+}
+
+// Finds the best teams of the elite attackers against the gym by estimating every lineup from
+// each attacker's results against each defender, runs gauntlets with the best few and writes
+// them ranked by win rate, then attackers lost; returns false if the gym could not be read or
+// the lineups could not be written
+static bool runLineup(const Options *opt, int attackers) {
+	Pokemon gym[MAX_GYM], team[MAX_TEAM];
+	Lineup lineups[LINEUP_VERIFY];
+	GauntletResult checked[LINEUP_VERIFY];
+	int gymSize = readInMons(opt->gym, gym, MAX_GYM), tasks = (opt->battles + GAUNTLET_CHUNK -
+		1) / GAUNTLET_CHUNK;
+	Gauntlet *gauntlet = (Gauntlet *)malloc(sizeof(Gauntlet));
+	FILE *fh = NULL;
+	GymRun run;
+	Sweep sweep;
+	bool valid = validMons(gym, gymSize) && attackers > 0, ok = valid;
+	run.parts = (GauntletResult *)malloc(sizeof(GauntletResult) * (size_t)tasks);
+	sweep.results = NULL;
+	if (!valid)
+		puts("Gym has an unknown pokemon or move, or there are no attackers");
+	else if (gauntlet != NULL && run.parts != NULL && fopen_s(&fh, opt->lineup, "w") == 0 &&
+			fh != NULL) {
+		// Every attacker against every defender of the gym on its own
+		sweep.attackers = &defenders[attackerOffset];
+		sweep.numAttackers = attackers;
+		sweep.defenders = gym;
+		sweep.numDefenders = gymSize;
+		sweep.tile = 1;
+		sweep.stream = NULL;
+		sweep.cache = NULL;
+		sweep.shard = 0;
+		sweep.numShards = 1;
+		sweep.cachedOnly = false;
+		ok = runSweep(&sweep, opt) && fputs("Strategy,Rank,Slot,Attacker,Attacker Basic,"
+			"Attacker Charge,Win Rate,Win Error,Average Losses,Average Beaten,Estimated Beaten,"
+			"Estimated Losses,Estimated Time\n", fh) >= 0;
+		run.gauntlet = gauntlet;
+		run.n = opt->battles;
+		run.seed = opt->seed;
+		for (int s = 0; s < NUM_STRATEGIES && ok; s++) {
+			int rank[LINEUP_VERIFY], found, place;
+			double start = getSeconds();
+			found = searchLineups(lineups, LINEUP_VERIFY, &sweep.results[s * gymSize *
+				attackers], attackers, gymSize, MAX_TEAM);
+			printf("\n-- %s: best of %d attackers vs %d defenders (searched in %.3f s) --\n",
+				STRAT_NAMES[STRATEGIES[s]], attackers, gymSize, getSeconds() - start);
+			run.strategy = STRATEGIES[s];
+			for (int i = 0; i < found && ok; i++) {
+				const Lineup *lineup = &lineups[i];
+				for (int j = 0; j < lineup->size; j++)
+					team[j] = defenders[attackerOffset + lineup->order[j]];
+				initGauntlet(gauntlet, team, lineup->size, gym, gymSize);
+				ok = runGauntlets(&run, tasks, opt->threads, &checked[i]);
+				// Rank by the gauntlets, keeping the estimated order for ties
+				place = i;
+				for (; place > 0 && betterGauntlet(&checked[i], &checked[rank[place - 1]]); place--)
+					rank[place] = rank[place - 1];
+				rank[place] = i;
+			}
+			for (int i = 0; i < found && ok; i++) {
+				const Lineup *lineup = &lineups[rank[i]];
+				const GauntletResult *result = &checked[rank[i]];
+				printf("%d. Won %.2f%% +/- %.2f%%, lost %.2f (estimated %d lost in %.0f s):",
+					i + 1, 100.0 * result->winRate, 100.0 * result->winError,
+					result->avgLosses, lineup->losses, lineup->time * 0.001);
+				for (int j = 0; j < lineup->size; j++) {
+					const Pokemon *mon = &defenders[attackerOffset + lineup->order[j]];
+					printf("%s %s [%s / %s]", (j > 0) ? "," : "", specData[mon->species].name,
+						moves[mon->basicMove].name, moves[mon->powerMove].name);
 				}
-				printf("\nAverage damage done to attacker: %.1f (%.2f%% loss rate)\n",
-					td / total, 100.0 * (double)totalWins / (50000.0 * total));
+				putchar('\n');
+				ok = writeLineup(fh, STRATEGIES[s], i + 1, lineup, result);
+			}
+		}
+	} else
+		ok = false;
+	if (fh != NULL)
+		ok = fclose(fh) == 0 && ok;
+	if (valid && !ok)
+		printf("Could not write lineups to %s\n", opt->lineup);
+	free(sweep.results);
+	free(run.parts);
+	free(gauntlet);
+	return ok;
+}
+
+// Sweeps every IV combination of each pokemon in the IV file over the level range against every
+// moveset of the defender, fighting only the variants that make different battles, and writes
+// every variant to the table; returns false if it could not be run or written. Only the
+// attacker's IVs vary, as the defender's are fixed at 10/10/10 like every other defender
+static bool runIvs(const Options *opt) {
+	Pokemon mons[MAX_TEAM];
+	int count = readInMons(opt->ivs, mons, MAX_TEAM), base = -1, movesets = 0;
+	FILE *fh = NULL;
+	bool valid = validMons(mons, count), ok = valid;
+	if (!valid)
+		puts("IV file has an unknown pokemon or move");
+	else {
+		base = getBasePokemon();
+		ok = base >= 0 && fopen_s(&fh, opt->table, "w") == 0 && fh != NULL && fputs(
+			IV_TABLE_HEADER, fh) >= 0;
+		if (ok)
+			movesets = countMovesets(base);
+	}
+	for (int i = 0; i < count && ok; i++) {
+		IvSweep ivs;
+		Sweep sweep;
+		const Pokemon *mon = &mons[i];
+		ok = initIvSweep(&ivs, mon, &defenders[base], movesets, opt->minLevel, opt->maxLevel);
+		if (ok) {
+			printf("\n%s [%s / %s]: %d distinct of %d variants\n", specData[mon->species].name,
+				moves[mon->basicMove].name, moves[mon->powerMove].name, ivs.numDistinct,
+				(opt->maxLevel - opt->minLevel + 1) * NUM_IV_COMBOS);
+			// The distinct variants are the attackers of an ordinary sweep
+			sweep.attackers = ivs.distinct;
+			sweep.numAttackers = ivs.numDistinct;
+			sweep.defenders = &defenders[base];
+			sweep.numDefenders = movesets;
+			sweep.tile = 1;
+			sweep.stream = NULL;
+			sweep.cache = NULL;
+			sweep.shard = 0;
+			sweep.numShards = 1;
+			sweep.cachedOnly = false;
+			ok = runSweep(&sweep, opt);
+			for (int s = 0; s < NUM_STRATEGIES && ok; s++) {
+				printf("-- %s --\n", STRAT_NAMES[STRATEGIES[s]]);
+				printIvLevels(&ivs, &sweep.results[s * movesets * ivs.numDistinct], movesets);
+			}
+			ok = ok && writeIvTable(fh, &ivs, sweep.results, STRATEGIES, NUM_STRATEGIES,
+				movesets);
+			free(sweep.results);
+			destroyIvSweep(&ivs);
+		}
+	}
+	if (fh != NULL)
+		ok = fclose(fh) == 0 && ok;
+	if (valid && !ok)
+		printf("Could not write IV table %s\n", opt->table);
+	return ok;
+}
+
+// Searches for the best planner policy of each elite attacker against every moveset of the
+// defender, and writes them to a CSV file with their scores on battles apart from the search,
+// next to the first strategy's score; returns false if it could not be run or written
+static bool runPolicy(const Options *opt, int attackers) {
+	MatchupContext ctx[MAX_TOTAL_MOVES];
+	FILE *fh = NULL;
+	int base = getBasePokemon(), movesets = (base >= 0) ? countMovesets(base) : 0;
+	uint64_t fresh = deriveSeed(opt->seed, RESCORE_TASK);
+	bool ok = base >= 0 && fopen_s(&fh, opt->policy, "w") == 0 && fh != NULL;
+	if (ok)
+		ok = fputs("Attacker,Attacker Basic,Attacker Charge,Dodge,Dodge Wait,Max Weave,Greedy,"
+			"Win Rate,Attacker Damage,Strategy Win Rate,Strategy Damage,Battles\n", fh) >= 0;
+	for (int a = 0; a < attackers && ok; a++) {
+		const Pokemon *attack = &defenders[attackerOffset + a];
+		Policy best, baseline;
+		PolicyScore score, fixed;
+		for (int d = 0; d < movesets; d++)
+			initMatchup(&ctx[d], attack, &defenders[base + d]);
+		ok = searchPolicy(&best, &score, ctx, movesets, opt->battles, opt->seed, opt->threads);
+		if (ok) {
+			// The winner's score on the battles that picked it is biased upwards, so score it
+			// again on fresh battles, and the fixed heuristic on the same ones for comparison
+			strategyPolicy(&baseline, STRATEGIES[0]);
+			scorePolicy(&score, &best, ctx, movesets, score.battles, fresh);
+			scorePolicy(&fixed, &baseline, ctx, movesets, score.battles, fresh);
+			printf("%s [%s / %s]: %.1f%% wins, %.1f%% damage taken (%.1f%%, %.1f%% by %s)\n",
+				specData[attack->species].name, moves[attack->basicMove].name,
+				moves[attack->powerMove].name, 100.0 * score.winRate, 100.0 * score.damage,
+				100.0 * fixed.winRate, 100.0 * fixed.damage, STRAT_NAMES[STRATEGIES[0]]);
+			ok = fprintf(fh, "%s,%s,%s,%d,%d,%d,%d,%.5f,%.5f,%.5f,%.5f,%d\n",
+				specData[attack->species].name, moves[attack->basicMove].name,
+				moves[attack->powerMove].name, best.dodge, best.dodgeWait, best.maxWeave,
+				best.greedy ? 1 : 0, score.winRate, score.damage, fixed.winRate, fixed.damage,
+				score.battles) > 0;
+		}
+	}
+	if (fh != NULL)
+		ok = fclose(fh) == 0 && ok;
+	if (!ok)
+		printf("Could not write policies to %s\n", opt->policy);
+	return ok;
+}
+
+// Ranks the elite attackers with every strategy against each moveset of the defender, all
+// fighting the same battles, and writes the rankings with the gap from each candidate to the
+// next to a CSV file; returns false if it could not be run or written
+static bool runCompare(const Options *opt, int attackers) {
+	RankedAttacker *ranked = (RankedAttacker *)malloc(sizeof(RankedAttacker) *
+		(size_t)(attackers * NUM_STRATEGIES));
+	FILE *fh = NULL;
+	int base = getBasePokemon(), count = attackers * NUM_STRATEGIES, movesets = (base >= 0) ?
+		countMovesets(base) : 0;
+	// Battles that independent estimates would need for the same intervals, over the battles
+	// fought, summed for the win rate and damage gaps, to show what pairing the battles saved
+	double saved[2] = { 0.0, 0.0 };
+	int pairs[2] = { 0, 0 };
+	bool ok = ranked != NULL && base >= 0 && fopen_s(&fh, opt->compare, "w") == 0 && fh != NULL;
+	if (ok)
+		ok = fputs("Defender,Defender Basic,Defender Charge,Rank,Attacker,Attacker Basic,"
+			"Attacker Charge,Strategy,Win Rate,Attacker Damage,Win Rate Gap,Gap Error,"
+			"Independent Gap Error,Damage Gap,Damage Gap Error,Independent Damage Gap Error,"
+			"Battles\n", fh) >= 0;
+	for (int d = 0; d < movesets && ok; d++) {
+		const Pokemon *defense = &defenders[base + d];
+		// Seeded by the defender alone, so every candidate gets the same rolls
+		uint64_t seed = deriveSeed(opt->seed, ((uint64_t)defense->species << 32) |
+			((uint64_t)defense->basicMove << 16) | (uint64_t)defense->powerMove);
+		ok = rankAttackers(ranked, &defenders[attackerOffset], attackers, STRATEGIES,
+			NUM_STRATEGIES, defense, opt->battles, seed, opt->threads);
+		if (ok)
+			printf("\n%s has %s / %s...\n", specData[defense->species].name,
+				moves[defense->basicMove].name, moves[defense->powerMove].name);
+		for (int r = 0; r < count && ok; r++) {
+			const RankedAttacker *cand = &ranked[r];
+			const Pokemon *attack = cand->attacker;
+			const PairedDiff *gap = &cand->next;
+			if (r < 10) {
+				printf("%2d. %s [%s / %s] %s: %.2f%% wins, %.1f%% damage taken\n", r + 1,
+					specData[attack->species].name, moves[attack->basicMove].name,
+					moves[attack->powerMove].name, STRAT_NAMES[cand->strategy], 100.0 *
+					cand->winRate, 100.0 * cand->damage);
+				printf("    Next: %+.2f%% +/- %.2f%% wins (%.2f%% independent), %+.2f%% +/- "
+					"%.2f%% damage (%.2f%% independent)\n", 100.0 * gap->winRate, 100.0 *
+					gap->winError, 100.0 * gap->winErrorUnpaired, 100.0 * gap->damage, 100.0 *
+					gap->damageError, 100.0 * gap->damageErrorUnpaired);
+			}
+			// Battles needed for the same interval go with its square
+			if (gap->winError > 0.0) {
+				saved[0] += pow(gap->winErrorUnpaired / gap->winError, 2.0);
+				pairs[0]++;
+			}
+			if (gap->damageError > 0.0) {
+				saved[1] += pow(gap->damageErrorUnpaired / gap->damageError, 2.0);
+				pairs[1]++;
+			}
+			ok = fprintf(fh, "%s,%s,%s,%d,%s,%s,%s,%s,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,"
+				"%d\n", specData[defense->species].name, moves[defense->basicMove].name,
+				moves[defense->powerMove].name, r + 1, specData[attack->species].name,
+				moves[attack->basicMove].name, moves[attack->powerMove].name,
+				STRAT_NAMES[cand->strategy], cand->winRate, cand->damage, gap->winRate,
+				gap->winError, gap->winErrorUnpaired, gap->damage, gap->damageError,
+				gap->damageErrorUnpaired, opt->battles) > 0;
+		}
+	}
+	if (ok && pairs[1] > 0)
+		printf("\nPaired battles pin down the gaps with %.1f (win rate) and %.1f (damage) times "
+			"fewer battles on average\n", (pairs[0] > 0) ? saved[0] / (double)pairs[0] : 1.0,
+			saved[1] / (double)pairs[1]);
+	if (fh != NULL)
+		ok = fclose(fh) == 0 && ok;
+	if (!ok)
+		printf("Could not write rankings to %s\n", opt->compare);
+	free(ranked);
+	return ok;
+}
+
+// Fights one battle of the sweep again while recording it, writes the trace and prints it, or
+// only prints the trace file if there is no battle to replay; returns false if the battle
+// could not be replayed or the trace could not be read or written
+static bool runTrace(const Options *opt, int attackers) {
+	bool ok = true;
+	if (opt->replayBattle >= 0) {
+		int base = getBasePokemon();
+		// The moveset must be one of the defender's own, not the next species in the roster
+		ok = base >= 0 && opt->replayAttacker < attackers && opt->replayDefender <
+			countMovesets(base);
+		if (ok) {
+			TraceInfo info;
+			MatchupContext ctx;
+			CacheKey key;
+			info.attacker = defenders[attackerOffset + opt->replayAttacker];
+			info.defender = defenders[base + opt->replayDefender];
+			info.strategy = STRATEGIES[0];
+			info.battle = opt->replayBattle;
+			// Seeded as sweepTask seeds the matchup, so the battle is the one the sweep fought
+			initMatchup(&ctx, &info.attacker, &info.defender);
+			matchupKey(&key, &ctx, info.strategy);
+			info.seed = deriveSeed(opt->seed, key.hash[0]);
+			replayBattle(&info);
+			ok = writeTrace(opt->trace, &info);
+			if (!ok)
+				printf("Could not write trace %s\n", opt->trace);
+		} else
+			puts("No such battle to replay");
+	}
+	if (ok) {
+		ok = printTrace(opt->trace);
+		if (!ok)
+			printf("Could not read trace %s\n", opt->trace);
+	}
+	return ok;
+}
+
+// Reads every shard file of a matrix into one cache; returns false if any are not valid
+static bool readShards(ResultCache *cache, const Options *opt) {
+	char name[SHARD_NAME_MAX];
+	bool ok = initCache(cache);
+	for (int i = 0; i < opt->merge && ok; i++)
+		if (!readCache(cache, shardName(name, sizeof(name), opt->matrix, i, opt->merge))) {
+			printf("Shard %s is not valid\n", name);
+			ok = false;
+		}
+	return ok;
+}
+
+// Runs every moveset of every species against every other and writes the matrix, the stream
+// or both; a shard is saved to its own file instead, and a merge takes every result from the
+// shard files; returns false if it could not be run or written
+static bool runMatrix(const Options *opt) {
+	Pokemon *movesets = (Pokemon *)malloc(sizeof(Pokemon) * NUM_SPECIES * MAX_TOTAL_MOVES);
+	ResultCache shards;
+	ResultStream stream;
+	Sweep sweep;
+	bool ok = false, ready = movesets != NULL;
+	sweep.results = NULL;
+	sweep.stream = NULL;
+	sweep.cache = NULL;
+	sweep.shard = opt->shard;
+	sweep.numShards = opt->numShards;
+	sweep.cachedOnly = opt->merge > 0;
+	if (sweep.cachedOnly && ready) {
+		ready = readShards(&shards, opt);
+		sweep.cache = &shards;
+	}
+	if (opt->stream != NULL && ready) {
+		ready = openStream(&stream, opt->stream);
+		if (ready)
+			sweep.stream = &stream;
+		else
+			printf("Could not create stream %s\n", opt->stream);
+	}
+	if (ready) {
+		int count = generateAllDefenders(movesets), missing = 0;
+		sweep.attackers = movesets;
+		sweep.numAttackers = count;
+		sweep.defenders = movesets;
+		sweep.numDefenders = count;
+		// Tiles keep each worker on a few pokemon at a time
+		sweep.tile = MATRIX_TILE;
+		if (opt->numShards > 1)
+			printf("Running shard %d of %d of %d movesets against each other...\n", opt->shard,
+				opt->numShards, count);
+		else
+			printf("Running %d movesets against each other...\n", count);
+		ok = runSweep(&sweep, opt);
+		if (ok && sweep.cachedOnly) {
+			// Matchups that no shard had, such as from shards run with other settings
+			for (int t = 0; t < NUM_STRATEGIES * count * count; t++)
+				if (sweep.results[t].ntimes < 0)
+					missing++;
+			if (missing > 0) {
+				printf("The shards are missing %d of %d matchups\n", missing,
+					NUM_STRATEGIES * count * count);
+				ok = false;
+			}
+		}
+		if (ok && opt->matrix != NULL && opt->numShards == 1) {
+			Matrix matrix;
+			matrix.results = sweep.results;
+			matrix.strategies = STRATEGIES;
+			matrix.numStrategies = NUM_STRATEGIES;
+			matrix.attackers = movesets;
+			matrix.numAttackers = count;
+			matrix.defenders = movesets;
+			matrix.numDefenders = count;
+			ok = writeMatrix(&matrix, opt->matrix);
+			if (ok)
+				printf("Wrote %d matchups to %s\n", NUM_STRATEGIES * count * count,
+					opt->matrix);
+			else
+				printf("Could not write matrix %s\n", opt->matrix);
+		}
+	}
+	if (sweep.stream != NULL) {
+		// Finish writing whatever was fought, even if the sweep failed
+		if (closeStream(&stream))
+			printf("Streamed %lld matchups to %s\n", stream.written, opt->stream);
+		else {
+			printf("Could not write stream %s\n", opt->stream);
+			ok = false;
+		}
+	}
+	if (opt->merge > 0 && movesets != NULL)
+		destroyCache(&shards);
+	free(sweep.results);
+	free(movesets);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	Options opt;
+	int attackers;
+	bool ok;
+	if (!parseOptions(&opt, argc, argv))
+		return 1;
+	// Rules come first, as nothing else depends on them until the battles
+	ok = opt.rules == NULL || readRules(opt.rules);
+	// Read in all data
+	attackers = ok ? readData(&opt) : -1;
+	ok = attackers >= 0;
+	if (ok && opt.compile == NULL) {
+		if (opt.bench != NULL)
+			ok = runBenchmark(opt.bench);
+		else if (opt.matrix != NULL || opt.stream != NULL)
+			ok = runMatrix(&opt);
+		else if (opt.grid != NULL)
+			ok = runGrid(&opt, attackers);
+		else if (opt.ivs != NULL)
+			ok = runIvs(&opt);
+		else if (opt.team != NULL)
+			ok = runGym(&opt);
+		else if (opt.lineup != NULL)
+			ok = runLineup(&opt, attackers);
+		else if (opt.policy != NULL)
+			ok = runPolicy(&opt, attackers);
+		else if (opt.compare != NULL)
+			ok = runCompare(&opt, attackers);
+		else if (opt.trace != NULL)
+			ok = runTrace(&opt, attackers);
+		else {
+			// Create top mons
+			int base = getBasePokemon(), movesets = (base >= 0) ? countMovesets(base) : 0;
+			if (movesets > 0 && attackers > 0) {
+				Sweep sweep;
+				// Send elite attackers against every moveset of the defender at once
+				sweep.attackers = &defenders[attackerOffset];
+				sweep.numAttackers = attackers;
+				sweep.defenders = &defenders[base];
+				sweep.numDefenders = movesets;
+				sweep.tile = 1;
+				sweep.stream = NULL;
+				sweep.cache = NULL;
+				sweep.shard = 0;
+				sweep.numShards = 1;
+				sweep.cachedOnly = false;
+				if (runSweep(&sweep, &opt))
+					printSweep(&sweep, &opt);
+				free(sweep.results);
 			}
+			// Done!
+			puts("Press ENTER to exit");
+			getchar();
 		}
-		// Done!
-		puts("Press ENTER to exit");
-		getchar();
-		destroyTimeline(&atkTL);
-		destroyTimeline(&defTL);
-		destroyAll();
 	}
-	return 0;
+	closeImage();
+	destroyAll();
+	return ok ? 0 : 1;
 }
@@ -1,431 +1,342 @@
 #include "stdafx.h"
-#include "battle.h"
+#include "engine.h"
 
-typedef struct _BattleStatus {
-	// Pokemon
-	const Pokemon *mon;
-	// Initial HP
-	int hp;
-	// Energy
-	int nrg;
-	// Damage done to
-	int damage;
-	// Timeline
-	Timeline *tl;
-} BattleStatus;
+// Fights the matchup once under the given rules (the context's, or constant DEFAULT_RULES),
+// with the attacker planning by the policy if there is one, or else the strategy, and the
+// defender drawing as in paired battles or not
+static FORCE_INLINE int doFight(BattleResult *setup, const MatchupContext *ctx,
+		const Rules *rules, int atkStrategy, const Policy *policy, bool paired,
+		Timeline *atkTL, Timeline *defTL, Random *rng) {
+	BattleStatus atk, def;
+	int now;
+	// Set up battle
+	clearTimeline(atkTL);
+	initBattle(&atk, &ctx->atk, rules, atkTL, NULL);
+#if defined(PRINT_RESULTS) && defined(_DEBUG)
+	puts("-- VS --");
+#endif
+	initBattle(&def, &ctx->def, rules, defTL, rng);
+	defenderStart(&def);
+	now = battleLoop(&atk, &def, atkStrategy, policy, paired, rules->maxTime);
+	STAT_BATTLE(atkTL, defTL, now);
+	return battleResult(setup, now, &atk, &def);
+}
+
+// Fills in one side of a matchup context
+static void initCombatant(Combatant *side, const Pokemon *mon, const Pokemon *foe,
+		const Rules *rules, int hpMult, int nrgMax) {
+	const Move *basic = &moves[mon->basicMove], *pwr = &moves[mon->powerMove];
+	int basicDamage = getRulesDamage(mon, foe, basic, rules), pwrDamage = getRulesDamage(mon,
+		foe, pwr, rules);
+	side->mon = mon;
+	side->foe = foe;
+	// HP = 2 * (BaseHP + IVHP), defender gets double
+	side->hp = hpMult * getHP(mon);
+	side->nrgMax = nrgMax;
+	// Waits and dodges do no damage, but anything dodged still does at least 1
+	for (int i = 0; i < NUM_EVENTS; i++) {
+		side->damage[i] = 0;
+		side->dodged[i] = 1;
+		side->window[i] = 0;
+		side->recover[i] = 0;
+	}
+	side->damage[EVENT_BASIC] = basicDamage;
+	side->damage[EVENT_SPECIAL] = pwrDamage;
+	basicDamage = basicDamage * rules->dodgePercent / 100;
+	pwrDamage = pwrDamage * rules->dodgePercent / 100;
+	if (basicDamage > 1)
+		side->dodged[EVENT_BASIC] = basicDamage;
+	if (pwrDamage > 1)
+		side->dodged[EVENT_SPECIAL] = pwrDamage;
+	side->window[EVENT_BASIC] = basic->window;
+	side->window[EVENT_SPECIAL] = pwr->window;
+	side->recover[EVENT_BASIC] = basic->cooldown - basic->window;
+	side->recover[EVENT_SPECIAL] = pwr->cooldown - pwr->window;
+	side->basicCooldown = basic->cooldown;
+	side->basicEnergy = basic->energyGen;
+	side->powerEnergy = pwr->energyReq;
+}
+
+// Works out everything about the matchup that stays the same from battle to battle
+void initMatchup(MatchupContext *ctx, const Pokemon *attack, const Pokemon *defense) {
+	initMatchupRules(ctx, attack, defense, &battleRules);
+}
 
-// Reports the next upcoming non-wait event of the timeline; if all the remaining events are
-// wait events, reports the time of the last planned event
-static FightEvent * planEvent(const Timeline *tl) {
-	int idx = tl->exec, max = tl->plan;
-	FightEvent *evt;
-	do {
-		evt = &(tl->data[idx++]);
-	} while (evt->type == EVENT_NOP && idx < max);
-	return evt;
+// Works out everything about the matchup that stays the same from battle to battle under the
+// given rules, which must outlive the context
+void initMatchupRules(MatchupContext *ctx, const Pokemon *attack, const Pokemon *defense,
+		const Rules *rules) {
+	initCombatant(&ctx->atk, attack, defense, rules, rules->atkHPMult, rules->atkNRGMax);
+	initCombatant(&ctx->def, defense, attack, rules, rules->defHPMult, rules->defNRGMax);
+	ctx->rules = rules;
 }
 
-// Adds an event to the timeline
-static int addEvent(const BattleStatus *status, int eventType, int duration) {
-	const Move *move;
-	Timeline *tl = status->tl;
-	const Pokemon *user = status->mon;
-	int advance = 0, time = 0, pi = tl->plan;
-	// Get time of last planned move
-	if (pi > 0) {
-		FightEvent *last = &(tl->data[pi - 1]);
-		time = last->time + last->duration;
+// Fights battles first .. first + count - 1 of the matchup under the given rules and adds them
+// to the totals; battles planned by a policy are paired, as policies are compared battle by
+// battle
+static FORCE_INLINE void runBattles(BattleTotals *totals, const MatchupContext *ctx,
+		const Rules *rules, int strategy, const Policy *policy, int first, int count,
+		uint64_t seed) {
+	BattleResult setup;
+	Timeline atkTL, defTL;
+	Random rng;
+	int result;
+	setup.attacking = ctx->atk.mon;
+	setup.defending = ctx->def.mon;
+	// Do it, and do it, and do it...
+	for (int i = first; i < first + count; i++) {
+		// Each battle has its own stream, so results never depend on the batch layout
+		seedRandom(&rng, seed, (uint64_t)i);
+		result = doFight(&setup, ctx, rules, strategy, policy, policy != NULL, &atkTL, &defTL,
+			&rng);
+		addBattle(totals, &setup, result);
 	}
-	switch (eventType) {
-	case EVENT_BASIC:
-		// Basic attack
-		move = &moves[user->basicMove];
-		advance = move->cooldown - move->window;
-		break;
-	case EVENT_SPECIAL:
-		// Special attack
-		move = &moves[user->powerMove];
-		advance = move->cooldown - move->window;
-		break;
-	case EVENT_NOP:
-	case EVENT_DODGE:
-		// Waits for the duration
-		advance = duration;
-		break;
-	default:
-		break;
+}
+
+// Fights battles first .. first + count - 1 of the matchup under the given rules and stores
+// the outcome of each
+static FORCE_INLINE void runOutcomes(BattleOutcome *outcomes, const MatchupContext *ctx,
+		const Rules *rules, int strategy, int first, int count, uint64_t seed) {
+	BattleResult setup;
+	Timeline atkTL, defTL;
+	Random rng;
+	setup.attacking = ctx->atk.mon;
+	setup.defending = ctx->def.mon;
+	for (int i = 0; i < count; i++) {
+		seedRandom(&rng, seed, (uint64_t)(first + i));
+		outcomes[i].won = doFight(&setup, ctx, rules, strategy, NULL, true, &atkTL, &defTL,
+			&rng) == 1;
+		outcomes[i].atkDamage = setup.atkDamage;
 	}
-	// Put event in
-	FightEvent *at = &(tl->data[pi]);
-	at->time = time;
-	at->type = eventType;
-	at->duration = advance;
-	// Move plan index up one (plan points to next empty index)
-	tl->plan = pi + 1;
-	return time;
 }
 
-// Reports the head event of the timeline
-static FightEvent * headEvent(const Timeline *tl) {
-	return &(tl->data[tl->exec]);
+// Fights battles of the matchup, the specialized kernels ignoring the strategy argument in
+// favor of the one they were compiled for
+typedef void (*BattleKernel)(BattleTotals *totals, const MatchupContext *ctx, int strategy,
+	int first, int count, uint64_t seed);
+
+// runBattles for STRAT_NO_DODGE and DEFAULT_RULES
+static void runNoDodge(BattleTotals *totals, const MatchupContext *ctx, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runBattles(totals, ctx, &DEFAULT_RULES, STRAT_NO_DODGE, NULL, first, count, seed);
 }
 
-// Initializes a battle status with pokemon stats
-static void initBattle(BattleStatus *stat, const Pokemon *mon, Timeline *tl, int hpMult) {
-	// HP = 2 * (BaseHP + IVHP), defender gets double
-	stat->hp = hpMult * getHP(mon);
-	stat->damage = 0;
-	stat->nrg = 0;
-	stat->mon = mon;
-	stat->tl = tl;
-	tl->data[0].time = 0;
-#if defined(PRINT_RESULTS) && defined(_DEBUG)
-	printPokemon(mon);
-#endif
+// runBattles for STRAT_DODGE_CHARGE and DEFAULT_RULES
+static void runDodgeCharge(BattleTotals *totals, const MatchupContext *ctx, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runBattles(totals, ctx, &DEFAULT_RULES, STRAT_DODGE_CHARGE, NULL, first, count, seed);
 }
 
-// Dodges the move!
-static inline int attackerDodge(BattleStatus *atk) {
-	return addEvent(atk, EVENT_DODGE, DODGE_TIME);
+// runBattles for STRAT_DODGE_ALL and DEFAULT_RULES
+static void runDodgeAll(BattleTotals *totals, const MatchupContext *ctx, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runBattles(totals, ctx, &DEFAULT_RULES, STRAT_DODGE_ALL, NULL, first, count, seed);
 }
 
-// Adds an attacker attack of the given type (assumes energy is available)
-static inline int attackerDoAttack(BattleStatus *atk, int now, int type) {
-	const Pokemon *attack = atk->mon;
-	Timeline *atkTL = atk->tl;
-	const Move *pwr = &moves[attack->powerMove], *basic = &moves[attack->basicMove];
-	int nrg = atk->nrg, when;
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-	const char *atkName = specData[attack->species].name;
-#endif
-	if (type == EVENT_SPECIAL) {
-		// Special! Usually the special can be charged during the previous dodge, but add half
-		// the charge time to make sure
-		when = addEvent(atk, EVENT_NOP, (CHARGE_TIME >> 1) + pwr->window) +
-			(CHARGE_TIME >> 1);
-		addEvent(atk, EVENT_SPECIAL, 0);
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-		printf("[ %05d ] %s queued %s at %d\n", now, atkName, pwr->name, when);
-#endif
-		nrg -= pwr->energyReq;
-	} else {
-		// Basic
-		when = addEvent(atk, EVENT_NOP, basic->window);
-		addEvent(atk, EVENT_BASIC, 0);
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-		printf("[ %05d ] %s queued %s at %d\n", now, atkName, basic->name, when);
-#endif
-		nrg += basic->energyGen;
-		if (nrg > ATK_NRG_MAX)
-			nrg = ATK_NRG_MAX;
-#if ATK_DELAY > 0
-		addEvent(atkTL, attack, EVENT_NOP, ATK_DELAY);
-#endif
-	}
-	atk->nrg = nrg;
-	return when;
+// runBattles for any strategy under the rules of the context
+static void runAnyRules(BattleTotals *totals, const MatchupContext *ctx, int strategy,
+		int first, int count, uint64_t seed) {
+	runBattles(totals, ctx, ctx->rules, strategy, NULL, first, count, seed);
 }
 
-// Store what happened (exclude the Victory! screen delay on principle)
-static inline int battleResult(BattleResult *setup, int et, BattleStatus *atk,
-		BattleStatus *def) {
-	int result;
-	// Display what happened
-#if defined(PRINT_RESULTS) && defined(_DEBUG)
-	printf("-- Battle over (%d.%03d s) --\n", et / 1000, et % 1000);
-	printf(" %s (%d HP) dealt %d damage\n", specData[setup->attacking->species].name, atk->hp -
-		atk->damage, def->damage);
-	printf(" %s (%d HP) dealt %d damage\n", specData[setup->defending->species].name, def->hp -
-		def->damage, atk->damage);
+// Battle loop for each STRAT_x, each holding only the planner branches of its strategy and
+// the default rules folded in as constants
+static const BattleKernel KERNELS[] = { runNoDodge, runDodgeCharge, runDodgeAll };
+
+// Picks the kernel for a matchup and strategy: a specialized one if the matchup uses the
+// default rules, otherwise the one that reads the rules as it goes
+static BattleKernel pickKernel(const MatchupContext *ctx, int strategy) {
+	return isDefaultRules(ctx->rules) ? KERNELS[strategy] : runAnyRules;
+}
+
+// Counts the events executed by both sides over the battles that repeatFight fights with the
+// same arguments
+long long countEvents(const Pokemon *attack, const Pokemon *defense, int n, int strategy,
+		uint64_t seed) {
+	MatchupContext ctx;
+	BattleResult setup;
+	Timeline atkTL, defTL;
+	Random rng;
+	long long events = 0LL;
+#ifdef BATTLE_STATS
+	BattleStats saved = threadStats;
 #endif
-	setup->timeLeft = MAX_TIME - et;
-	setup->atkDamage = atk->damage;
-	setup->defDamage = def->damage;
-	// Who won?
-	result = 1;
-	if (def->damage < def->hp) {
-		if (atk->damage > atk->hp)
-			// Ties go to the attacker
-			result = -1;
-		else
-			// Timeouts go to the defender
-			result = 0;
+	initMatchup(&ctx, attack, defense);
+	setup.attacking = attack;
+	setup.defending = defense;
+	for (int i = 0; i < n; i++) {
+		seedRandom(&rng, seed, (uint64_t)i);
+		doFight(&setup, &ctx, ctx.rules, strategy, NULL, false, &atkTL, &defTL, &rng);
+		// Timelines count every event executed since they were cleared
+		events += (long long)atkTL.exec + (long long)defTL.exec;
 	}
-#if defined(PRINT_RESULTS) && defined(_DEBUG)
-	if (result > 0)
-		puts("Attacker won!");
-	else
-		puts("Defender won!");
+#ifdef BATTLE_STATS
+	// These battles were only counted, not fought
+	threadStats = saved;
 #endif
-	return result;
+	return events;
+}
+
+// Stores the averages of the totals and their confidence intervals in the result
+void storeTotals(RepeatBattleResult *result, const BattleTotals *totals) {
+	int n = totals->n;
+	double nd = (double)n, mean = (double)totals->totalAD / nd, var = 0.0, p;
+	result->ntimes = n;
+	result->atkWins = totals->atkWins;
+	result->winRate = (double)totals->atkWins / nd;
+	result->avgAtkDamage = mean;
+	result->avgDefDamage = (double)totals->totalDD / nd;
+	result->avgTimeLeft = (double)totals->totalTimeLeft / nd;
+	// Agresti-Coull interval, which stays sensible for lopsided matchups
+	p = ((double)totals->atkWins + 2.0) / (nd + 4.0);
+	result->winError = CONFIDENCE_Z * sqrt(p * (1.0 - p) / (nd + 4.0));
+	if (n > 1)
+		var = ((double)totals->totalAD2 - mean * (double)totals->totalAD) / (nd - 1.0);
+	result->atkDamageError = (var > 0.0) ? CONFIDENCE_Z * sqrt(var / nd) : 0.0;
 }
 
-// Adds a random defender delay from DEF_DELAY to DEF_DELAY + DEF_DELAY_RANGE
-static inline void defenderAddDelay(BattleStatus *def) {
-	//https://www.reddit.com/r/TheSilphRoad/comments/52b453/testing_gym_combat_misconceptions_2/
-	unsigned int rnd;
-	int delay;
-	if (rand_s(&rnd) != 0)
-		// Default
-		delay = DEF_DELAY_RANGE >> 1;
+// Fights battles first .. first + n - 1 of a matchup context that is already set up, seeded as
+// repeatFight seeds them but paired (see defenderAttack), and stores the outcome of each; the
+// same battle meets the same defender rolls for every attacker and strategy
+void fightOutcomes(BattleOutcome *outcomes, const MatchupContext *ctx, int first, int n,
+		int strategy, uint64_t seed) {
+	// Folds the strategy and the default rules in, as the kernels do
+	if (!isDefaultRules(ctx->rules))
+		runOutcomes(outcomes, ctx, ctx->rules, strategy, first, n, seed);
+	else if (strategy == STRAT_NO_DODGE)
+		runOutcomes(outcomes, ctx, &DEFAULT_RULES, STRAT_NO_DODGE, first, n, seed);
+	else if (strategy == STRAT_DODGE_CHARGE)
+		runOutcomes(outcomes, ctx, &DEFAULT_RULES, STRAT_DODGE_CHARGE, first, n, seed);
 	else
-		// In integer, convert to (0..1) * DEF_DELAY_RANGE
-		delay = ((int)(rnd & 0xFFFFU) * DEF_DELAY_RANGE + 0x7FFF) / 0xFFFF;
-	addEvent(def, EVENT_NOP, DEF_DELAY + delay);
+		runOutcomes(outcomes, ctx, &DEFAULT_RULES, STRAT_DODGE_ALL, first, n, seed);
 }
 
-// Adds a defender attack, randomly choosing special if there is enough energy
-static inline int defenderAttack(BattleStatus *def, int now) {
-	const Pokemon *defense = def->mon;
-	const Move *pwr = &moves[defense->powerMove], *basic = &moves[defense->basicMove];
-	unsigned int rnd;
-	int nrg = def->nrg, need = pwr->energyReq, when;
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-	const char *defName = specData[defense->species].name;
-#endif
-	if (nrg > need && rand_s(&rnd) == 0 && (rnd & 0xFFFF) < DEF_PROB) {
-		// Special! Defender does not need to charge, but does wait afterwards
-		when = addEvent(def, EVENT_NOP, pwr->window);
-		addEvent(def, EVENT_SPECIAL, 0);
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-		printf("[ %05d ] %s queued %s at %d\n", now, defName, pwr->name, when);
-#endif
-		nrg -= need;
-	} else {
-		when = addEvent(def, EVENT_NOP, basic->window);
-		addEvent(def, EVENT_BASIC, 0);
-#if defined(PRINT_QUEUES) && defined(_DEBUG)
-		printf("[ %05d ] %s queued %s at %d\n", now, defName, basic->name, when);
-#endif
-		nrg += basic->energyGen;
-		if (nrg > DEF_NRG_MAX)
-			nrg = DEF_NRG_MAX;
+// Fights over and over again and records summary stats
+void repeatFight(RepeatBattleResult *result, const Pokemon *attack, const Pokemon *defense,
+		int n, int strategy, uint64_t seed) {
+	MatchupContext ctx;
+	if (result != NULL) {
+		result->attacking = attack;
+		result->defending = defense;
+		result->ntimes = 0;
+		if (n > 0) {
+			initMatchup(&ctx, attack, defense);
+			repeatFightContext(result, &ctx, n, strategy, seed);
+		}
 	}
-	// Delay after
-	//https://www.reddit.com/r/TheSilphRoad/comments/4wzll7/testing_gym_combat_misconceptions
-	defenderAddDelay(def);
-	def->nrg = nrg;
-	return when;
 }
 
-// Prepares the initial fixed defender strategy
-static inline void defenderStart(BattleStatus *def) {
-	const Move *defBasic = &moves[def->mon->basicMove];
-	int cd = defBasic->cooldown;
-	clearTimeline(def->tl);
-	// Defender has a fixed initial strategy, which does generate energy!
-	// Starts attack at T=1, starts attack again at T=2 (even if first attack not finished!)
-	addEvent(def, EVENT_NOP, 1000 + cd);
-	addEvent(def, EVENT_BASIC, 0);
-	// 1000 + cd in, need to hit again at 2000 + cd, basic attacks take 0 time
-	addEvent(def, EVENT_NOP, 1000);
-	addEvent(def, EVENT_BASIC, 0);
-	// Third attack was based on a 2s delay after the first one ends (1000+cd), needs to start
-	// at 3000+cd, currently at 2000+cd
-	addEvent(def, EVENT_NOP, 1000);
-	def->nrg = defBasic->energyGen;
+// Fights battles first .. first + n - 1 of a matchup context that is already set up, with the
+// attacker planning by a policy instead of a strategy, paired as in fightOutcomes
+void repeatFightPolicy(RepeatBattleResult *result, const MatchupContext *ctx, int first, int n,
+		const Policy *policy, uint64_t seed) {
+	BattleTotals totals;
+	memset(&totals, 0, sizeof(totals));
+	result->attacking = ctx->atk.mon;
+	result->defending = ctx->def.mon;
+	result->ntimes = 0;
+	if (n > 0) {
+		// The strategy is not used with a policy, but the rules can still be folded
+		if (isDefaultRules(ctx->rules))
+			runBattles(&totals, ctx, &DEFAULT_RULES, STRAT_NO_DODGE, policy, first, n, seed);
+		else
+			runBattles(&totals, ctx, ctx->rules, STRAT_NO_DODGE, policy, first, n, seed);
+		storeTotals(result, &totals);
+	}
 }
 
-// Executes the head move of the specified timeline
-static int execute(BattleStatus *status, const Pokemon *victim, bool dodge) {
-	Timeline *timeline = status->tl;
-	const Pokemon *user = status->mon;
-	// All information is in the status, how useful!
-	int idx = timeline->exec, type, damage = 0;
-	FightEvent *evt = &timeline->data[idx];
-	const Move *move = NULL;
-#if defined(PRINT_ALL_ACTIONS) && defined(_DEBUG)
-	const char *name = specData[user->species].name;
-#endif
-	type = evt->type;
-	// Damage the victim if this was an attack move
-	if (type == EVENT_BASIC)
-		move = &moves[user->basicMove];
-	else if (type == EVENT_SPECIAL)
-		move = &moves[user->powerMove];
-	if (move != NULL) {
-#if defined(PRINT_DAMAGE) && defined(_DEBUG)
-		// Prefix the damage notification
-		printf("[ %05d ] ", evt->time);
-#endif
-		damage = getDamage(user, victim, move, dodge);
-	}
-#if defined(PRINT_ALL_ACTIONS) && defined(_DEBUG)
-	else if (type == EVENT_DODGE)
-		printf("[ %05d ] %s dodged!\n", evt->time, name);
-	else
-		printf("[ %05d ] %s waits for %d\n", evt->time, name, evt->duration);
-#endif
-	timeline->exec = idx + 1;
-	return damage;
+// Sets up the policy that plans the same way as a STRAT_x strategy under battleRules
+void strategyPolicy(Policy *policy, int strategy) {
+	initStrategyPolicy(policy, strategy, &battleRules);
 }
 
-// Calculates the next attacker plan
-static inline void nextAttackerAttack(BattleStatus *atk, BattleStatus *def, int now,
-		int atkStrategy) {
-	const Pokemon *attack = atk->mon;
-	const Move *basic = &moves[attack->basicMove];
-	FightEvent *prevAtk = atk->tl->lastAttack, *nextDef = planEvent(def->tl);
-	// Find out how much energy is needed and if we, they have power now
-	int attackEnd = prevAtk->time + prevAtk->duration, cutoff = nextDef->time - attackEnd,
-		nextType = nextDef->type, lastType = def->tl->lastAttack->type;
-	bool defHasNRG = def->nrg >= moves[def->mon->powerMove].energyReq, atkHasNRG =
-		atk->nrg >= moves[attack->powerMove].energyReq, dodged = prevAtk->type == EVENT_DODGE;
-	if (atkStrategy == STRAT_NO_DODGE)
-		// Queue one attack always
-		attackerDoAttack(atk, now, atkHasNRG ? EVENT_SPECIAL : EVENT_BASIC);
-	else if (cutoff > 0) {
-		// Calculate how long until next defender attack and how much we can do before then
-		// Subtract one from cutoff to make sure that ties err on the side of caution
-		int rate = basic->cooldown + ATK_DELAY, qty = (cutoff - 1) / rate, dodgeTime,
-			leftover = cutoff - (rate * qty);
-		if (atkHasNRG && nextType != EVENT_SPECIAL && (!defHasNRG || (dodged &&
-				lastType == EVENT_SPECIAL)))
-			// Queue special attack if defender just used its own or cannot use it
-			attackerDoAttack(atk, now, EVENT_SPECIAL);
-		else if (atkStrategy == STRAT_DODGE_ALL || nextType == EVENT_SPECIAL) {
-			// Attack until next defender attack
-			for (int i = 0; i < qty; i++)
-				attackerDoAttack(atk, now, EVENT_BASIC);
-			// Wait until the damage window starts
-			if (leftover > DODGE_WAIT)
-				addEvent(atk, EVENT_NOP, leftover - DODGE_WAIT);
-			// Dodge
-			dodgeTime = attackerDodge(atk);
-#if defined(PRINT_PLAN) && defined(_DEBUG)
-			printf("[ %05d ] Attacking %d times before dodge at %d\n", now, qty, dodgeTime);
-#else
-			(void)dodgeTime;
-#endif
-		} else
-			// Just hit them, use special if they cannot possibly have energy
-			attackerDoAttack(atk, now, (defHasNRG || !atkHasNRG) ? EVENT_BASIC :
-				EVENT_SPECIAL);
+// Fights n battles of a matchup context that is already set up with each of up to NUM_STRATS
+// strategies (any more are left out); battle i is seeded the same for every strategy, so each
+// result is what repeatFight gives for its strategy with the same seed, and the strategies face
+// the same defender rolls
+void repeatFightStrategies(RepeatBattleResult *results, const MatchupContext *ctx, int n,
+		const int *strategies, int numStrategies, uint64_t seed) {
+	BattleTotals totals[NUM_STRATS];
+	if (numStrategies > NUM_STRATS)
+		numStrategies = NUM_STRATS;
+	memset(totals, 0, sizeof(totals));
+	// Take turns a batch at a time, so the damage tables stay in cache for every strategy
+	for (int first = 0; first < n; first += ADAPT_BATCH) {
+		int count = (n - first < ADAPT_BATCH) ? n - first : ADAPT_BATCH;
+		for (int s = 0; s < numStrategies; s++)
+			pickKernel(ctx, strategies[s])(&totals[s], ctx, strategies[s], first, count, seed);
+	}
+	for (int s = 0; s < numStrategies; s++) {
+		RepeatBattleResult *result = &results[s];
+		result->attacking = ctx->atk.mon;
+		result->defending = ctx->def.mon;
+		result->ntimes = 0;
+		if (n > 0)
+			storeTotals(result, &totals[s]);
 	}
 }
 
-// Fights the pokemon provided in the battle setup!
-static int doFight(BattleResult *setup, int atkStrategy, Timeline *atkTL, Timeline *defTL) {
-	BattleStatus atk, def;
-	int now = 0, nextAT, nextDT, dd, energy;
-	const Pokemon *attack = setup->attacking, *defense = setup->defending;
-	FightEvent *nextAtk, *nextDef;
-	// Set up battle
-	clearTimeline(atkTL);
-	initBattle(&atk, attack, atkTL, ATK_HP_MULT);
-#if defined(PRINT_RESULTS) && defined(_DEBUG)
-	puts("-- VS --");
-#endif
-	initBattle(&def, defense, defTL, DEF_HP_MULT);
-	defenderStart(&def);
-	// Battle loop
-	while (now < MAX_TIME && atk.damage < atk.hp && def.damage < def.hp) {
-		// If planned events are exhausted, plan next attack/defense
-		if (defTL->exec >= defTL->plan)
-			defenderAttack(&def, now);
-		if (atkTL->exec >= atkTL->plan)
-			nextAttackerAttack(&atk, &def, now, atkStrategy);
-		// Advance to the next event
-		nextDef = headEvent(defTL);
-		nextDT = nextDef->time;
-		nextAtk = headEvent(atkTL);
-		nextAT = nextAtk->time;
-		if (nextDT >= nextAT) {
-			// Move attacker timeline, defender cannot dodge at this time
-			if (nextAtk->type != EVENT_NOP)
-				atkTL->lastAttack = nextAtk;
-			dd = execute(&atk, defense, false);
-			// Every 2 damage done, add NRG
-			energy = def.nrg + (dd + HP_TO_ENERGY - 1) / HP_TO_ENERGY;
-			if (energy > DEF_NRG_MAX)
-				energy = DEF_NRG_MAX;
-			def.nrg = energy;
-			def.damage += dd;
-		}
-		if (nextDT <= nextAT) {
-			bool dodge;
-			if (nextDef->type != EVENT_NOP)
-				defTL->lastAttack = nextDef;
-			// Need to use the previous event as any dodges have been retired!
-			nextAtk = atkTL->lastAttack;
-			dodge = nextAtk->type == EVENT_DODGE && nextAtk->time + nextAtk->duration > nextDT;
-			dd = execute(&def, attack, dodge);
-			// Every 2 damage done, add NRG (rounds up)
-			energy = atk.nrg + (dd + HP_TO_ENERGY - 1) / HP_TO_ENERGY;
-			if (energy > ATK_NRG_MAX)
-				energy = ATK_NRG_MAX;
-			atk.nrg = energy;
-			// Move defender timeline
-			nextAT = nextDT;
-			// Dodge damage needs to be calculated now!
-			if (dodge) {
-				dd = dd * MULT_DODGE;
-				if (dd < 1) dd = 1;
-			}
-			atk.damage += dd;
-		}
-		now = nextAT;
+// Same as repeatFight on a matchup context that is already set up
+void repeatFightContext(RepeatBattleResult *result, const MatchupContext *ctx, int n,
+		int strategy, uint64_t seed) {
+	BattleTotals totals;
+	memset(&totals, 0, sizeof(totals));
+	result->attacking = ctx->atk.mon;
+	result->defending = ctx->def.mon;
+	result->ntimes = 0;
+	if (n > 0) {
+		pickKernel(ctx, strategy)(&totals, ctx, strategy, 0, n, seed);
+		// Average and store stats
+		storeTotals(result, &totals);
 	}
-	return battleResult(setup, now, &atk, &def);
 }
 
-// Fights over and over again and records summary stats
-void repeatFight(RepeatBattleResult *result, const Pokemon *attack, const Pokemon *defense,
-		int n, int strategy) {
-	BattleResult setup;
-	Timeline atkTL, defTL;
+// Fights batches of ADAPT_BATCH battles until the 95% confidence intervals of the win rate
+// and of the damage done to the attacker (as a fraction of its HP) are both within
+// +/- precision, or maxN battles have been fought
+void repeatFightAdaptive(RepeatBattleResult *result, const Pokemon *attack,
+		const Pokemon *defense, double precision, int maxN, int strategy, uint64_t seed) {
+	MatchupContext ctx;
+	BattleTotals totals;
 	if (result != NULL) {
-		// Set up
-		int totalAD = 0, totalDD = 0, atkWins = 0;
-		// The extra 2bil does help for 10000+ runs!
-		unsigned int totalTimeLeft = 0;
-		setup.attacking = attack;
-		setup.defending = defense;
-		initTimeline(&atkTL);
-		initTimeline(&defTL);
-		// If memory available
-		if (atkTL.data != NULL && defTL.data != NULL && n > 0) {
-			double nd = (double)n;
-			result->ntimes = n;
-			// Do it, and do it, and do it...
-			for (int i = 0; i < n; i++) {
-				atkWins += (doFight(&setup, strategy, &atkTL, &defTL) == 1) ? 1 : 0;
-				totalAD += setup.atkDamage;
-				totalDD += setup.defDamage;
-				totalTimeLeft += (unsigned int)setup.timeLeft;
-			}
-			// Average and store stats
-			result->attacking = attack;
-			result->defending = defense;
-			result->atkWins = atkWins;
-			result->avgAtkDamage = (double)totalAD / nd;
-			result->avgDefDamage = (double)totalDD / nd;
-			result->avgTimeLeft = (double)totalTimeLeft / nd;
-			// Clean up
-			destroyTimeline(&atkTL);
-			destroyTimeline(&defTL);
-		} else
-			result->ntimes = 0;
+		BattleKernel kernel;
+		bool done = false;
+		memset(&totals, 0, sizeof(totals));
+		result->attacking = attack;
+		result->defending = defense;
+		result->ntimes = 0;
+		initMatchup(&ctx, attack, defense);
+		kernel = pickKernel(&ctx, strategy);
+		while (!done && totals.n < maxN) {
+			int count = maxN - totals.n;
+			if (count > ADAPT_BATCH)
+				count = ADAPT_BATCH;
+			// Battle numbers carry on from the last batch, so any n matches repeatFight
+			kernel(&totals, &ctx, strategy, totals.n, count, seed);
+			storeTotals(result, &totals);
+			done = result->winError <= precision && result->atkDamageError <= precision *
+				(double)ctx.atk.hp;
+		}
 	}
 }
 
 // Fights once and reports the stats
-int fight(BattleResult *result, const Pokemon *attack, const Pokemon *defense, int strategy) {
+int fight(BattleResult *result, const Pokemon *attack, const Pokemon *defense, int strategy,
+		uint64_t seed) {
+	MatchupContext ctx;
 	Timeline atkTL, defTL;
+	Random rng;
 	int ret = 0;
 	// Set up
 	if (result != NULL) {
 		result->attacking = attack;
 		result->defending = defense;
-		initTimeline(&atkTL);
-		initTimeline(&defTL);
-		// If memory available
-		if (atkTL.data != NULL && defTL.data != NULL) {
-			ret = doFight(result, strategy, &atkTL, &defTL);
-			// Clean up
-			destroyTimeline(&atkTL);
-			destroyTimeline(&defTL);
-		}
+		initMatchup(&ctx, attack, defense);
+		seedRandom(&rng, seed, 0ULL);
+		ret = doFight(result, &ctx, ctx.rules, strategy, NULL, false, &atkTL, &defTL, &rng);
 	}
 	return ret;
 }
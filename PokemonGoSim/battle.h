@@ -1,9 +1,115 @@
 #pragma once
 
 #include "pokemon.h"
+#include "rules.h"
 
-// Fights once and reports the stats
-int fight(BattleResult *result, const Pokemon *attack, const Pokemon *defense, int strategy);
-// Fights over and over again and records summary stats
+// Battles fought between precision checks by repeatFightAdaptive
+#define ADAPT_BATCH 256
+// Normal quantile for the 95% confidence intervals reported in RepeatBattleResult
+#define CONFIDENCE_Z 1.96
+// Most basic attacks planned before one dodge, so that a plan always fits in the timeline
+#define MAX_PLAN_ATTACKS ((TIMELINE_LEN - 2) / 3)
+
+// Defender attacks that a Policy dodges (anything that is not a special counts as basic)
+#define DODGE_BASIC 1
+#define DODGE_SPECIAL 2
+
+// Settings of the attacker planner, generalizing the fixed STRAT_x heuristics
+typedef struct _Policy {
+	// DODGE_x flags of the defender attacks to dodge, or 0 to attack without ever dodging
+	int dodge;
+	// Time before the damage window closes that a late dodge starts
+	int dodgeWait;
+	// Most basic attacks woven in before a dodge (at most MAX_PLAN_ATTACKS)
+	int maxWeave;
+	// Fire the special whenever the next defender attack is not one, even if the defender
+	// could answer with its own
+	bool greedy;
+} Policy;
+
+// What one battle of a matchup came to, for comparing matchups battle by battle
+typedef struct _BattleOutcome {
+	// Damage done to the attacker
+	int atkDamage;
+	// Whether the attacker won
+	bool won;
+} BattleOutcome;
+
+// Everything about one side of a matchup that stays the same from battle to battle
+typedef struct _Combatant {
+	// Pokemon on this side
+	const Pokemon *mon;
+	// Pokemon on the other side
+	const Pokemon *foe;
+	// HP including the attacker or defender multiplier
+	int hp;
+	// Maximum energy
+	int nrgMax;
+	// Damage done to the foe by each EVENT_x (0 for waits and dodges)
+	int damage[NUM_EVENTS];
+	// Damage done to the foe by each EVENT_x if the foe dodges
+	int dodged[NUM_EVENTS];
+	// Time from the start of each attack EVENT_x until the damage is done
+	int window[NUM_EVENTS];
+	// Time from the damage of each attack EVENT_x until the move is over
+	int recover[NUM_EVENTS];
+	// Basic move cooldown
+	int basicCooldown;
+	// Energy generated by the basic move
+	int basicEnergy;
+	// Energy needed for the special move
+	int powerEnergy;
+} Combatant;
+
+// Everything about a matchup that stays the same from battle to battle, built once so that
+// the battle loop only reads integers from tables
+typedef struct _MatchupContext {
+	// Attacker stats and damage to the defender
+	Combatant atk;
+	// Defender stats and damage to the attacker
+	Combatant def;
+	// Rules the tables were built with (battleRules when the matchup was set up)
+	const Rules *rules;
+} MatchupContext;
+
+// Counts the events executed by both sides over the battles that repeatFight fights with the
+// same arguments
+long long countEvents(const Pokemon *attack, const Pokemon *defense, int n, int strategy,
+	uint64_t seed);
+// Fights once and reports the stats; the seed picks the defender's random choices
+int fight(BattleResult *result, const Pokemon *attack, const Pokemon *defense, int strategy,
+	uint64_t seed);
+// Fights batches of ADAPT_BATCH battles until the 95% confidence intervals of the win rate
+// and of the damage done to the attacker (as a fraction of its HP) are both within
+// +/- precision, or maxN battles have been fought
+void repeatFightAdaptive(RepeatBattleResult *result, const Pokemon *attack,
+	const Pokemon *defense, double precision, int maxN, int strategy, uint64_t seed);
+// Works out everything about the matchup that stays the same from battle to battle
+void initMatchup(MatchupContext *ctx, const Pokemon *attack, const Pokemon *defense);
+// Works out everything about the matchup that stays the same from battle to battle under the
+// given rules, which must outlive the context
+void initMatchupRules(MatchupContext *ctx, const Pokemon *attack, const Pokemon *defense,
+	const Rules *rules);
+// Fights battles first .. first + n - 1 of a matchup context that is already set up, seeded as
+// repeatFight seeds them but paired (see defenderAttack), and stores the outcome of each; the
+// same battle meets the same defender rolls for every attacker and strategy
+void fightOutcomes(BattleOutcome *outcomes, const MatchupContext *ctx, int first, int n,
+	int strategy, uint64_t seed);
+// Fights over and over again and records summary stats; the same seed gives the same results
 void repeatFight(RepeatBattleResult *result, const Pokemon *attack, const Pokemon *defense,
-	int n, int strategy);
+	int n, int strategy, uint64_t seed);
+// Fights battles first .. first + n - 1 of a matchup context that is already set up, with the
+// attacker planning by a policy instead of a strategy, paired as in fightOutcomes
+void repeatFightPolicy(RepeatBattleResult *result, const MatchupContext *ctx, int first, int n,
+	const Policy *policy, uint64_t seed);
+// Sets up the policy that plans the same way as a STRAT_x strategy under battleRules
+void strategyPolicy(Policy *policy, int strategy);
+// Fights n battles of a matchup context that is already set up with each of up to NUM_STRATS
+// strategies (any more are left out); battle i is seeded the same for every strategy, so each
+// result is what repeatFight gives for its strategy with the same seed, and the strategies face
+// the same defender rolls
+void repeatFightStrategies(RepeatBattleResult *results, const MatchupContext *ctx, int n,
+	const int *strategies, int numStrategies, uint64_t seed);
+// Same as repeatFight on a matchup context that is already set up
+void repeatFightContext(RepeatBattleResult *result, const MatchupContext *ctx, int n,
+	int strategy, uint64_t seed);
@@ -0,0 +1,255 @@
+#include "stdafx.h"
+#include "battle.h"
+#include "bench.h"
+#include "platform.h"
+
+// Battles timed for each case, engine and strategy
+#define BENCH_BATTLES 20000
+// Matchup setups timed for each case
+#define BENCH_SETUPS 200000
+// Times everything is run; the fastest run counts, which filters out noise from other programs
+#define BENCH_RUNS 3
+// Shortest run in seconds; quicker engines are repeated until they take this long
+#define BENCH_MIN_SECONDS 0.1
+// Seed of every benchmark battle
+#define BENCH_SEED 20160807ULL
+// Most measurements kept from a baseline file
+#define BENCH_MAX_LINES 64
+// Longest measurement label
+#define BENCH_LABEL_MAX 32U
+// Engines timed: initMatchup (and so getDamage) and repeatFight
+#define BENCH_SETUP 0
+#define BENCH_SCALAR 1
+#define NUM_BENCH_ENGINES 2
+// Strategies timed, STRAT_x
+#define NUM_BENCH_STRATEGIES (STRAT_DODGE_ALL + 1)
+
+typedef struct _BenchCase {
+	// Label in the report and in the baseline
+	const char *name;
+	// Species, basic move and charge move of the attacker and of the defender
+	const char *attack[3];
+	const char *defense[3];
+} BenchCase;
+
+// Matchups timed, covering the common case and both extremes of battle length
+static const BenchCase BENCH_CASES[] = {
+	// Even battle that uses most of the clock
+	{ "typical", { "Vaporeon", "Water Gun", "Hydro Pump" }, { "Lapras", "Frost Breath",
+		"Blizzard" } },
+	// Attacker faints within seconds
+	{ "short", { "Dugtrio", "Mud Slap", "Earthquake" }, { "Poliwrath", "Bubble",
+		"Hydro Pump" } },
+	// Nobody faints, so every battle runs until MAX_TIME
+	{ "timeout", { "Chansey", "Pound", "Dazzling Gleam" }, { "Chansey", "Pound",
+		"Dazzling Gleam" } }
+};
+#define NUM_BENCH_CASES ((int)(sizeof(BENCH_CASES) / sizeof(BenchCase)))
+
+// Labels of the engines and of the STRAT_x strategies
+static const char * const ENGINE_LABELS[NUM_BENCH_ENGINES] = { "setup", "scalar" };
+static const char * const STRAT_LABELS[NUM_BENCH_STRATEGIES] = { "none", "charge", "all" };
+
+// Rates of a benchmark run, by measurement label
+typedef struct _Baseline {
+	char label[BENCH_MAX_LINES][BENCH_LABEL_MAX];
+	// Battles (or setups) per second
+	double rate[BENCH_MAX_LINES];
+	int count;
+} Baseline;
+
+// Creates a 10/10/10 level 41 (Poke Go level 20.5, as createL20Poke makes them) pokemon from its
+// species and move names; returns false if any of them are not known
+static bool benchPokemon(Pokemon *mon, const char * const *names) {
+	mon->species = getSpeciesName(names[0]);
+	mon->level = 41;
+	mon->ivAttack = 10;
+	mon->ivDefense = 10;
+	mon->ivHP = 10;
+	mon->basicMove = getMoveName(names[1]);
+	mon->powerMove = getMoveName(names[2]);
+	return mon->species >= 0 && mon->basicMove >= 0 && mon->powerMove >= 0;
+}
+
+// Reads a baseline file; returns false if there is none
+static bool readBaseline(Baseline *base, const char *fileName) {
+	FILE *fh;
+	bool found = false;
+	base->count = 0;
+	if (fopen_s(&fh, fileName, "r") == 0 && fh != NULL) {
+		while (base->count < BENCH_MAX_LINES && 2 == fscanf_s(fh, "%s %lf ",
+				base->label[base->count], BENCH_LABEL_MAX, &base->rate[base->count]))
+			base->count++;
+		fclose(fh);
+		found = true;
+	}
+	return found;
+}
+
+// Writes a baseline file; returns false if it could not be written
+static bool writeBaseline(const Baseline *base, const char *fileName) {
+	FILE *fh;
+	bool ok = false;
+	if (fopen_s(&fh, fileName, "w") == 0 && fh != NULL) {
+		ok = true;
+		for (int i = 0; i < base->count && ok; i++)
+			ok = fprintf(fh, "%s %.0f\n", base->label[i], base->rate[i]) > 0;
+		ok = fclose(fh) == 0 && ok;
+	}
+	return ok;
+}
+
+// Gets the baseline rate of a measurement, or 0 if it has none
+static double findBaseline(const Baseline *base, const char *label) {
+	double rate = 0.0;
+	for (int i = 0; i < base->count && rate <= 0.0; i++)
+		if (strcmp(base->label[i], label) == 0)
+			rate = base->rate[i];
+	return rate;
+}
+
+// Runs one engine once on a matchup, returning the time taken in seconds
+static double runEngine(int engine, const Pokemon *attack, const Pokemon *defense,
+		int strategy) {
+	RepeatBattleResult result;
+	MatchupContext ctx;
+	double start = getSeconds();
+	if (engine == BENCH_SETUP)
+		for (int i = 0; i < BENCH_SETUPS; i++)
+			initMatchup(&ctx, attack, defense);
+	else
+		repeatFight(&result, attack, defense, BENCH_BATTLES, strategy, BENCH_SEED);
+	return getSeconds() - start;
+}
+
+// Times one engine and strategy on a matchup, prints the results against the baseline and
+// adds them to the new baseline; returns false if it was slower than the baseline allows
+static bool benchOne(Baseline *now, const Baseline *base, const char *name, int engine,
+		int strategy, const Pokemon *attack, const Pokemon *defense) {
+	char label[BENCH_LABEL_MAX], allocText[16], changeText[16];
+	int items = (engine == BENCH_SETUP) ? BENCH_SETUPS : BENCH_BATTLES;
+	double best = 0.0, allocs = 0.0, rate, perItem, baseRate;
+	bool ok = true;
+	if (engine == BENCH_SETUP)
+		snprintf(label, sizeof(label), "%s/%s", name, ENGINE_LABELS[engine]);
+	else
+		snprintf(label, sizeof(label), "%s/%s/%s", name, ENGINE_LABELS[engine],
+			STRAT_LABELS[strategy]);
+	for (int i = 0; i < BENCH_RUNS; i++) {
+#ifdef COUNT_ALLOCATIONS
+		long long start = getAllocations();
+#endif
+		double time = 0.0;
+		int reps = 0;
+		do {
+			time += runEngine(engine, attack, defense, strategy);
+			reps++;
+		} while (time < BENCH_MIN_SECONDS);
+		time /= (double)reps;
+		if (i == 0 || time < best)
+			best = time;
+#ifdef COUNT_ALLOCATIONS
+		allocs = (double)(getAllocations() - start) / (double)reps;
+#endif
+	}
+	rate = (double)items / best;
+	// Time per event of the battles, or per setup
+	if (engine == BENCH_SETUP)
+		perItem = best * 1e9 / (double)items;
+	else
+		perItem = best * 1e9 / (double)countEvents(attack, defense, BENCH_BATTLES, strategy,
+			BENCH_SEED);
+#ifdef COUNT_ALLOCATIONS
+	snprintf(allocText, sizeof(allocText), "%.3f", allocs / (double)items);
+#else
+	(void)allocs;
+	strcpy_s(allocText, sizeof(allocText), "-");
+#endif
+	baseRate = findBaseline(base, label);
+	if (baseRate > 0.0) {
+		snprintf(changeText, sizeof(changeText), "%+.1f%%", 100.0 * (rate / baseRate - 1.0));
+		ok = rate >= baseRate * (1.0 - BENCH_TOLERANCE);
+	} else
+		strcpy_s(changeText, sizeof(changeText), "new");
+	printf("%-24s %12.0f %10.2f %8s %8s%s\n", label, rate, perItem, allocText, changeText,
+		ok ? "" : "  SLOWER");
+	if (now->count < BENCH_MAX_LINES) {
+		strcpy_s(now->label[now->count], BENCH_LABEL_MAX, label);
+		now->rate[now->count++] = rate;
+	}
+	return ok;
+}
+
+// Checks that fighting every strategy of a matchup in one repeatFightStrategies call gives the
+// same results as one repeatFight per strategy; returns false if any of them differ
+static bool checkStrategies(const char *name, const Pokemon *attack, const Pokemon *defense) {
+	RepeatBattleResult together[NUM_BENCH_STRATEGIES], alone;
+	MatchupContext ctx;
+	int strategies[NUM_BENCH_STRATEGIES];
+	bool same = true;
+	for (int s = 0; s < NUM_BENCH_STRATEGIES; s++)
+		strategies[s] = s;
+	initMatchup(&ctx, attack, defense);
+	repeatFightStrategies(together, &ctx, BENCH_BATTLES, strategies, NUM_BENCH_STRATEGIES,
+		BENCH_SEED);
+	for (int s = 0; s < NUM_BENCH_STRATEGIES && same; s++) {
+		const RepeatBattleResult *result = &together[s];
+		repeatFight(&alone, attack, defense, BENCH_BATTLES, s, BENCH_SEED);
+		// Same battles summed the same way, so even the averages match exactly
+		same = result->ntimes == alone.ntimes && result->atkWins == alone.atkWins &&
+			result->avgAtkDamage == alone.avgAtkDamage && result->avgDefDamage ==
+			alone.avgDefDamage && result->avgTimeLeft == alone.avgTimeLeft;
+		if (!same)
+			printf("%s/%s: repeatFightStrategies does not match repeatFight\n", name,
+				STRAT_LABELS[s]);
+	}
+	return same;
+}
+
+// Times every case, engine and strategy and compares the rates with the baseline file, or
+// writes the baseline if there is none yet, and checks that repeatFightStrategies matches
+// repeatFight; returns false if anything is slower than the baseline by more than
+// BENCH_TOLERANCE, a check fails or the benchmark could not be run
+bool runBenchmark(const char *baseline) {
+	Baseline *base = (Baseline *)malloc(sizeof(Baseline) * 2U);
+	bool ok = base != NULL, found = false, fast = true, checked = true;
+	if (ok) {
+		found = readBaseline(&base[0], baseline);
+		base[1].count = 0;
+		printf("%-24s %12s %10s %8s %8s\n", "Case/engine/strategy", "Rate/s", "ns/event",
+			"Allocs", "Change");
+		for (int c = 0; c < NUM_BENCH_CASES; c++) {
+			const BenchCase *bench = &BENCH_CASES[c];
+			Pokemon attack, defense;
+			if (benchPokemon(&attack, bench->attack) && benchPokemon(&defense,
+					bench->defense)) {
+				for (int e = 0; e < NUM_BENCH_ENGINES; e++)
+					// Setup does not depend on the strategy
+					for (int s = 0; s < ((e == BENCH_SETUP) ? 1 : NUM_BENCH_STRATEGIES); s++)
+						fast = benchOne(&base[1], &base[0], bench->name, e, s, &attack,
+							&defense) && fast;
+				checked = checkStrategies(bench->name, &attack, &defense) && checked;
+			} else {
+				printf("Benchmark case %s uses a pokemon or move that is not loaded\n",
+					bench->name);
+				ok = false;
+			}
+		}
+		if (checked)
+			puts("repeatFightStrategies matches repeatFight on every case");
+		if (!found) {
+			// First run sets the baseline
+			if (writeBaseline(&base[1], baseline))
+				printf("Wrote baseline %s\n", baseline);
+			else {
+				printf("Could not write baseline %s\n", baseline);
+				ok = false;
+			}
+		} else if (!fast)
+			printf("Slower than baseline %s by more than %.0f%%\n", baseline, 100.0 *
+				BENCH_TOLERANCE);
+		ok = ok && fast && checked;
+	}
+	free(base);
+	return ok;
+}
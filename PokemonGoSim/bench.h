@@ -0,0 +1,15 @@
+#pragma once
+
+// Throughput benchmark of the battle engines on a fixed set of matchups, compared against a
+// stored baseline
+
+#include "pokemon.h"
+
+// Slowdown against the baseline that counts as a regression
+#define BENCH_TOLERANCE 0.10
+
+// Times every case, engine and strategy and compares the rates with the baseline file, or
+// writes the baseline if there is none yet, and checks that repeatFightStrategies matches
+// repeatFight; returns false if anything is slower than the baseline by more than
+// BENCH_TOLERANCE, a check fails or the benchmark could not be run
+bool runBenchmark(const char *baseline);
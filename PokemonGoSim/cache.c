@@ -0,0 +1,190 @@
+#include "stdafx.h"
+#include "cache.h"
+#include "platform.h"
+#include "random.h"
+
+// Starts the file, followed by the entry count and the entries
+static const char CACHE_MAGIC[8] = { 'P', 'G', 'S', 'C', 'A', 'C', 'H', 'E' };
+// Slots in a new cache (a power of 2)
+#define CACHE_START_SIZE 1024U
+// Longest cache file name
+#define CACHE_NAME_MAX 256U
+
+// Adds a value (such as a setting that changes the result) to a key
+void addKey(CacheKey *key, uint64_t value) {
+	// A zero hash marks an empty slot
+	key->hash[0] = mixRandom(key->hash[0] + value) | 1ULL;
+	key->hash[1] = mixRandom((key->hash[1] ^ value) * RANDOM_GAMMA + 1ULL);
+}
+
+// Adds an array of ints to a key
+static void addInts(CacheKey *key, const int *values, int count) {
+	for (int i = 0; i < count; i++)
+		addKey(key, (uint64_t)(uint32_t)values[i]);
+}
+
+// Adds everything about one side of a matchup except the pokemon pointers to a key
+static void addCombatant(CacheKey *key, const Combatant *side) {
+	int stats[] = { side->hp, side->nrgMax, side->basicCooldown, side->basicEnergy,
+		side->powerEnergy };
+	addInts(key, stats, (int)(sizeof(stats) / sizeof(int)));
+	addInts(key, side->damage, NUM_EVENTS);
+	addInts(key, side->dodged, NUM_EVENTS);
+	addInts(key, side->window, NUM_EVENTS);
+	addInts(key, side->recover, NUM_EVENTS);
+}
+
+// Finds the slot of a key, or the empty slot where it would go
+static CacheEntry * findSlot(const ResultCache *cache, const CacheKey *key) {
+	size_t mask = cache->mask, idx = (size_t)key->hash[0] & mask;
+	CacheEntry *entry = &cache->entries[idx];
+	while (entry->key.hash[0] != 0ULL && (entry->key.hash[0] != key->hash[0] ||
+			entry->key.hash[1] != key->hash[1])) {
+		idx = (idx + 1U) & mask;
+		entry = &cache->entries[idx];
+	}
+	return entry;
+}
+
+// Doubles the number of slots; returns false if out of memory
+static bool growCache(ResultCache *cache) {
+	CacheEntry *old = cache->entries;
+	size_t size = cache->mask + 1U;
+	bool ok = false;
+	cache->entries = (CacheEntry *)calloc(size << 1, sizeof(CacheEntry));
+	if (cache->entries != NULL) {
+		cache->mask = (size << 1) - 1U;
+		for (size_t i = 0; i < size; i++)
+			if (old[i].key.hash[0] != 0ULL)
+				*findSlot(cache, &old[i].key) = old[i];
+		free(old);
+		ok = true;
+	} else
+		cache->entries = old;
+	return ok;
+}
+
+// Adds an entry to the cache if its key is not already there; returns false if out of memory
+static bool addEntry(ResultCache *cache, const CacheEntry *entry) {
+	CacheEntry *slot;
+	bool ok = true;
+	// Keep at least half of the slots empty
+	if (((cache->count + 1U) << 1) > cache->mask + 1U)
+		ok = growCache(cache);
+	if (ok) {
+		slot = findSlot(cache, &entry->key);
+		if (slot->key.hash[0] == 0ULL) {
+			*slot = *entry;
+			cache->count++;
+			cache->added++;
+		}
+	}
+	return ok;
+}
+
+// Adds a result to the cache if it is not already there; returns false if out of memory
+bool addResult(ResultCache *cache, const CacheKey *key, const RepeatBattleResult *result) {
+	CacheEntry entry;
+	entry.key = *key;
+	entry.avgAtkDamage = result->avgAtkDamage;
+	entry.avgDefDamage = result->avgDefDamage;
+	entry.avgTimeLeft = result->avgTimeLeft;
+	entry.winRate = result->winRate;
+	entry.winError = result->winError;
+	entry.atkDamageError = result->atkDamageError;
+	entry.ntimes = result->ntimes;
+	entry.atkWins = result->atkWins;
+	return addEntry(cache, &entry);
+}
+
+// Deallocates the cache
+void destroyCache(ResultCache *cache) {
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0U;
+}
+
+// Looks up a result, filling in everything but the pokemon; returns false if not cached
+bool findResult(const ResultCache *cache, const CacheKey *key, RepeatBattleResult *result) {
+	const CacheEntry *entry = findSlot(cache, key);
+	bool found = entry->key.hash[0] != 0ULL;
+	if (found) {
+		result->avgAtkDamage = entry->avgAtkDamage;
+		result->avgDefDamage = entry->avgDefDamage;
+		result->avgTimeLeft = entry->avgTimeLeft;
+		result->winRate = entry->winRate;
+		result->winError = entry->winError;
+		result->atkDamageError = entry->atkDamageError;
+		result->ntimes = entry->ntimes;
+		result->atkWins = entry->atkWins;
+	}
+	return found;
+}
+
+// Creates an empty cache; returns false if out of memory
+bool initCache(ResultCache *cache) {
+	cache->entries = (CacheEntry *)calloc(CACHE_START_SIZE, sizeof(CacheEntry));
+	cache->mask = CACHE_START_SIZE - 1U;
+	cache->count = 0U;
+	cache->added = 0U;
+	return cache->entries != NULL;
+}
+
+// Starts the key of a matchup from its stats, damage tables, strategy and the battle constants
+void matchupKey(CacheKey *key, const MatchupContext *ctx, int strategy) {
+	key->hash[0] = 0ULL;
+	key->hash[1] = 0ULL;
+	const Rules *rules = ctx->rules;
+	// Rules used by the engines directly instead of through the combatant tables
+	int engine[] = { CACHE_VERSION, rules->hpToEnergy, rules->dodgeTime, rules->dodgeWait,
+		rules->chargeTime, rules->atkDelay, rules->defDelay, rules->defDelayRange,
+		rules->defProb, rules->maxTime, TIMELINE_LEN };
+	addInts(key, engine, (int)(sizeof(engine) / sizeof(int)));
+	// The context holds every species, move and pokemon stat that makes it to the battle
+	addCombatant(key, &ctx->atk);
+	addCombatant(key, &ctx->def);
+	addKey(key, (uint64_t)strategy);
+}
+
+// Adds every entry of a cache file (if there is one) to the cache; returns false if the file
+// is not a valid cache
+bool readCache(ResultCache *cache, const char *fileName) {
+	FILE *fh;
+	bool ok = true;
+	if (fopen_s(&fh, fileName, "rb") == 0 && fh != NULL) {
+		char magic[sizeof(CACHE_MAGIC)];
+		uint64_t count;
+		CacheEntry entry;
+		ok = fread(magic, sizeof(magic), 1, fh) == 1 && memcmp(magic, CACHE_MAGIC,
+			sizeof(magic)) == 0 && fread(&count, sizeof(count), 1, fh) == 1;
+		for (uint64_t i = 0; i < count && ok; i++)
+			ok = fread(&entry, sizeof(entry), 1, fh) == 1 && entry.key.hash[0] != 0ULL &&
+				addEntry(cache, &entry);
+		fclose(fh);
+		// Nothing is new yet
+		cache->added = 0U;
+	}
+	return ok;
+}
+
+// Writes the whole cache to a file; returns false if the file could not be written
+bool writeCache(const ResultCache *cache, const char *fileName) {
+	char temp[CACHE_NAME_MAX + 8U];
+	FILE *fh;
+	bool ok = false;
+	// Write a new file and swap it in, so a failed write never loses the old cache
+	snprintf(temp, sizeof(temp), "%s.tmp", fileName);
+	if (fopen_s(&fh, temp, "wb") == 0 && fh != NULL) {
+		uint64_t count = (uint64_t)cache->count;
+		ok = fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC), 1, fh) == 1 && fwrite(&count,
+			sizeof(count), 1, fh) == 1;
+		for (size_t i = 0; i <= cache->mask && ok; i++)
+			if (cache->entries[i].key.hash[0] != 0ULL)
+				ok = fwrite(&cache->entries[i], sizeof(CacheEntry), 1, fh) == 1;
+		ok = fclose(fh) == 0 && ok;
+		ok = ok && replaceFile(temp, fileName);
+		if (!ok)
+			remove(temp);
+	}
+	return ok;
+}
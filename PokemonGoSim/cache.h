@@ -0,0 +1,55 @@
+#pragma once
+
+// On-disk cache of matchup results, keyed by a hash of everything that can change a result
+
+#include "battle.h"
+
+// Change whenever the battle rules change in a way that the hashed constants do not show
+#define CACHE_VERSION 1
+
+typedef struct _CacheKey {
+	// Two independent hashes, so that different matchups never share a key in practice
+	uint64_t hash[2];
+} CacheKey;
+
+typedef struct _CacheEntry {
+	// Matchup and settings that gave this result (all zero for an empty slot)
+	CacheKey key;
+	// Copy of the RepeatBattleResult numbers
+	double avgAtkDamage;
+	double avgDefDamage;
+	double avgTimeLeft;
+	double winRate;
+	double winError;
+	double atkDamageError;
+	int ntimes;
+	int atkWins;
+} CacheEntry;
+
+typedef struct _ResultCache {
+	// Open addressing hash table with (mask + 1) slots
+	CacheEntry *entries;
+	size_t mask;
+	// Entries in the table
+	size_t count;
+	// Entries added since the cache was read
+	size_t added;
+} ResultCache;
+
+// Adds a value (such as a setting that changes the result) to a key
+void addKey(CacheKey *key, uint64_t value);
+// Adds a result to the cache if it is not already there; returns false if out of memory
+bool addResult(ResultCache *cache, const CacheKey *key, const RepeatBattleResult *result);
+// Deallocates the cache
+void destroyCache(ResultCache *cache);
+// Looks up a result, filling in everything but the pokemon; returns false if not cached
+bool findResult(const ResultCache *cache, const CacheKey *key, RepeatBattleResult *result);
+// Creates an empty cache; returns false if out of memory
+bool initCache(ResultCache *cache);
+// Starts the key of a matchup from its stats, damage tables, strategy and the battle constants
+void matchupKey(CacheKey *key, const MatchupContext *ctx, int strategy);
+// Adds every entry of a cache file (if there is one) to the cache; returns false if the file
+// is not a valid cache
+bool readCache(ResultCache *cache, const char *fileName);
+// Writes the whole cache to a file; returns false if the file could not be written
+bool writeCache(const ResultCache *cache, const char *fileName);
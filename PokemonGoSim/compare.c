@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "compare.h"
+#include "scheduler.h"
+
+// Every candidate of a ranking fighting the same battles
+typedef struct _RankRun {
+	RankedAttacker *ranked;
+	int numStrategies;
+	const Pokemon *defense;
+	// Outcomes of each candidate's battles, n per candidate
+	BattleOutcome *outcomes;
+	int n;
+	uint64_t seed;
+	// HP of each candidate, as the damage is compared as a fraction of it
+	int *hp;
+} RankRun;
+
+// Fights the battles of one attacker with every strategy and averages them; the strategies
+// share the matchup context
+static void rankTask(void *context, int task, int worker) {
+	RankRun *run = (RankRun *)context;
+	MatchupContext ctx;
+	(void)worker;
+	initMatchup(&ctx, run->ranked[task * run->numStrategies].attacker, run->defense);
+	for (int s = 0; s < run->numStrategies; s++) {
+		int c = task * run->numStrategies + s;
+		RankedAttacker *cand = &run->ranked[c];
+		BattleOutcome *outcomes = &run->outcomes[(size_t)c * (size_t)run->n];
+		long long wins = 0LL, damage = 0LL;
+		// The same seed for everyone is what makes the battles common
+		fightOutcomes(outcomes, &ctx, 0, run->n, cand->strategy, run->seed);
+		for (int i = 0; i < run->n; i++) {
+			if (outcomes[i].won)
+				wins++;
+			damage += (long long)outcomes[i].atkDamage;
+		}
+		run->hp[c] = ctx.atk.hp;
+		cand->winRate = (double)wins / (double)run->n;
+		cand->damage = (double)damage / ((double)run->n * (double)ctx.atk.hp);
+	}
+}
+
+// Orders candidates from best to worst for qsort
+static int compareRanked(const void *a, const void *b) {
+	const RankedAttacker *ra = (const RankedAttacker *)a, *rb = (const RankedAttacker *)b;
+	int order = ra->order - rb->order;
+	if (ra->winRate != rb->winRate)
+		order = (ra->winRate > rb->winRate) ? -1 : 1;
+	else if (ra->damage != rb->damage)
+		order = (ra->damage < rb->damage) ? -1 : 1;
+	return order;
+}
+
+// Works out the gap between two candidates from the outcomes of the same n battles
+void pairOutcomes(PairedDiff *diff, const BattleOutcome *a, int hpA, const BattleOutcome *b,
+		int hpB, int n) {
+	// Sums of each side and of the gaps, and of their squares
+	double sum[3][2], sum2[3][2], nd = (double)n, var[3][2];
+	memset(sum, 0, sizeof(sum));
+	memset(sum2, 0, sizeof(sum2));
+	for (int i = 0; i < n; i++) {
+		double wa = a[i].won ? 1.0 : 0.0, wb = b[i].won ? 1.0 : 0.0, da =
+			(double)a[i].atkDamage / (double)hpA, db = (double)b[i].atkDamage / (double)hpB;
+		double value[3][2] = { { wa, da }, { wb, db }, { wa - wb, da - db } };
+		for (int s = 0; s < 3; s++)
+			for (int k = 0; k < 2; k++) {
+				sum[s][k] += value[s][k];
+				sum2[s][k] += value[s][k] * value[s][k];
+			}
+	}
+	for (int s = 0; s < 3; s++)
+		for (int k = 0; k < 2; k++) {
+			var[s][k] = 0.0;
+			if (n > 1)
+				var[s][k] = (sum2[s][k] - sum[s][k] * sum[s][k] / nd) / (nd - 1.0);
+			if (var[s][k] < 0.0)
+				var[s][k] = 0.0;
+		}
+	diff->winRate = sum[2][0] / nd;
+	diff->winError = CONFIDENCE_Z * sqrt(var[2][0] / nd);
+	diff->winErrorUnpaired = CONFIDENCE_Z * sqrt((var[0][0] + var[1][0]) / nd);
+	diff->damage = sum[2][1] / nd;
+	diff->damageError = CONFIDENCE_Z * sqrt(var[2][1] / nd);
+	diff->damageErrorUnpaired = CONFIDENCE_Z * sqrt((var[0][1] + var[1][1]) / nd);
+}
+
+// Fights battles 0 .. n - 1 of every attacker with every strategy against the defender, all
+// with the same seed so that each battle has the same defender rolls for every candidate, then
+// ranks them by win rate, then least damage taken, and measures the gap from each to the next.
+// Stores numAttackers * numStrategies candidates, best first; returns false if the battles
+// could not be fought
+bool rankAttackers(RankedAttacker *ranked, const Pokemon *attackers, int numAttackers,
+		const int *strategies, int numStrategies, const Pokemon *defense, int n, uint64_t seed,
+		int threads) {
+	RankRun run;
+	int count = numAttackers * numStrategies;
+	bool ok = false;
+	run.ranked = ranked;
+	run.numStrategies = numStrategies;
+	run.defense = defense;
+	run.n = n;
+	run.seed = seed;
+	run.outcomes = (BattleOutcome *)malloc(sizeof(BattleOutcome) * (size_t)count * (size_t)n);
+	run.hp = (int *)malloc(sizeof(int) * (size_t)count);
+	if (run.outcomes != NULL && run.hp != NULL && n > 0) {
+		memset(ranked, 0, sizeof(RankedAttacker) * (size_t)count);
+		for (int i = 0; i < count; i++) {
+			ranked[i].attacker = &attackers[i / numStrategies];
+			ranked[i].strategy = strategies[i % numStrategies];
+			ranked[i].order = i;
+		}
+		ok = runTasks(rankTask, &run, numAttackers, threads);
+	}
+	if (ok) {
+		qsort(ranked, (size_t)count, sizeof(RankedAttacker), compareRanked);
+		// The order still finds each candidate's battles
+		for (int r = 0; r + 1 < count; r++) {
+			int a = ranked[r].order, b = ranked[r + 1].order;
+			pairOutcomes(&ranked[r].next, &run.outcomes[(size_t)a * (size_t)n], run.hp[a],
+				&run.outcomes[(size_t)b * (size_t)n], run.hp[b], n);
+		}
+	}
+	free(run.hp);
+	free(run.outcomes);
+	return ok;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// Ranking of attackers and strategies against one defender with common random numbers: every
+// candidate fights the same battles with the same defender rolls, so the gap between two
+// candidates is measured battle by battle, which takes far fewer battles to pin down than the
+// gap between two independent estimates
+
+#include "battle.h"
+
+// Gap between two candidates over the same battles (first minus second)
+typedef struct _PairedDiff {
+	// Win rate gap, and its 95% confidence interval half width from the paired battles and
+	// as if the candidates had fought independent battles
+	double winRate;
+	double winError;
+	double winErrorUnpaired;
+	// Same for the damage done to the attacker as a fraction of its HP
+	double damage;
+	double damageError;
+	double damageErrorUnpaired;
+} PairedDiff;
+
+// One attacker and strategy in a ranking
+typedef struct _RankedAttacker {
+	const Pokemon *attacker;
+	// STRAT_x
+	int strategy;
+	// Win rate and damage taken as a fraction of HP over the shared battles
+	double winRate;
+	double damage;
+	// Gap to the next candidate in the ranking (all zero for the last one)
+	PairedDiff next;
+	// Candidate number (attacker * strategies + strategy), which breaks ties
+	int order;
+} RankedAttacker;
+
+// Works out the gap between two candidates from the outcomes of the same n battles
+void pairOutcomes(PairedDiff *diff, const BattleOutcome *a, int hpA, const BattleOutcome *b,
+	int hpB, int n);
+// Fights battles 0 .. n - 1 of every attacker with every strategy against the defender, all
+// with the same seed so that each battle has the same defender rolls for every candidate, then
+// ranks them by win rate, then least damage taken, and measures the gap from each to the next.
+// Stores numAttackers * numStrategies candidates, best first; returns false if the battles
+// could not be fought
+bool rankAttackers(RankedAttacker *ranked, const Pokemon *attackers, int numAttackers,
+	const int *strategies, int numStrategies, const Pokemon *defense, int n, uint64_t seed,
+	int threads);
@@ -0,0 +1,475 @@
+#pragma once
+
+// Battle engine internals shared by the battle kernels; everything else should use battle.h
+
+#include "battle.h"
+#include "random.h"
+#include "rules.h"
+#include "stats.h"
+#include "trace.h"
+
+// Inlines a function even where the compiler would rather not, so that constant arguments
+// (such as the strategy) are folded into the caller
+#ifdef _MSC_VER
+#define FORCE_INLINE __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+// Head of a timeline with nothing planned
+static const FightEvent IDLE_EVENT = { INT_MAX, EVENT_NOP, 0, 0 };
+
+typedef struct _BattleStatus {
+	// Fixed stats and damage table for this side
+	const Combatant *side;
+	// Rules of the battle (DEFAULT_RULES in the specialized kernels, so that they fold)
+	const Rules *rules;
+	// Energy
+	int nrg;
+	// Damage done to
+	int damage;
+	// Timeline
+	Timeline *tl;
+	// Random numbers for the defender's choices
+	Random *rng;
+} BattleStatus;
+
+// Running totals over a series of battles of one matchup
+typedef struct _BattleTotals {
+	// Battles fought
+	int n;
+	// Attacker wins
+	int atkWins;
+	// Damage done to attacker, and its sum of squares
+	long long totalAD;
+	long long totalAD2;
+	// Damage done to defender
+	long long totalDD;
+	// Time left on the battle clock in ms
+	long long totalTimeLeft;
+} BattleTotals;
+
+// Stores the averages of the totals and their confidence intervals in the result
+void storeTotals(RepeatBattleResult *result, const BattleTotals *totals);
+
+// Adds one battle (with the result reported by battleResult) to the totals
+static inline void addBattle(BattleTotals *totals, const BattleResult *setup, int result) {
+	long long ad = (long long)setup->atkDamage;
+	totals->n++;
+	if (result == 1)
+		totals->atkWins++;
+	totals->totalAD += ad;
+	totals->totalAD2 += ad * ad;
+	totals->totalDD += (long long)setup->defDamage;
+	totals->totalTimeLeft += (long long)setup->timeLeft;
+}
+
+// Reports the next upcoming non-wait event of the timeline; if all the remaining events are
+// wait events, reports the time of the last planned event
+static inline const FightEvent * planEvent(const Timeline *tl) {
+	int idx = tl->exec, max = tl->plan;
+	const FightEvent *evt;
+	do {
+		evt = &(tl->data[idx++ & TIMELINE_MASK]);
+	} while (evt->type == EVENT_NOP && idx < max);
+	STAT_ADD(nopSkips, idx - tl->exec - 1);
+	return evt;
+}
+
+// Adds an event to the timeline
+static inline int addEvent(const BattleStatus *status, int eventType, int duration) {
+	Timeline *tl = status->tl;
+	int advance, time = 0, pi = tl->plan;
+	// Get time of last planned move
+	if (pi > 0) {
+		FightEvent *last = &(tl->data[(pi - 1) & TIMELINE_MASK]);
+		time = last->time + last->duration;
+	}
+	if (eventType == EVENT_BASIC || eventType == EVENT_SPECIAL)
+		// Attacks take the rest of the move after the damage window
+		advance = status->side->recover[eventType];
+	else
+		// Waits for the duration
+		advance = duration;
+	// Put event in
+	FightEvent *at = &(tl->data[pi & TIMELINE_MASK]);
+	at->time = time;
+	at->type = eventType;
+	at->duration = advance;
+	at->energy = 0;
+	// Move plan index up one (plan points to next empty index)
+	tl->plan = pi + 1;
+	return time;
+}
+
+// Reports the head event of the timeline, which never happens if nothing is planned
+static inline const FightEvent * headEvent(const Timeline *tl) {
+	int exec = tl->exec;
+	return (exec < tl->plan) ? &(tl->data[exec & TIMELINE_MASK]) : &IDLE_EVENT;
+}
+
+// Initializes a battle status with pokemon stats
+static inline void initBattle(BattleStatus *stat, const Combatant *side, const Rules *rules,
+		Timeline *tl, Random *rng) {
+	stat->damage = 0;
+	stat->nrg = 0;
+	stat->side = side;
+	stat->rules = rules;
+	stat->tl = tl;
+	stat->rng = rng;
+#if defined(PRINT_RESULTS) && defined(_DEBUG)
+	printPokemon(side->mon);
+#endif
+}
+
+// Dodges the move!
+static inline int attackerDodge(BattleStatus *atk) {
+	STAT_ADD(dodges, 1);
+	return addEvent(atk, EVENT_DODGE, atk->rules->dodgeTime);
+}
+
+// Adds an attacker attack of the given type (assumes energy is available)
+static inline int attackerDoAttack(BattleStatus *atk, int now, int type) {
+	const Combatant *side = atk->side;
+	Timeline *tl = atk->tl;
+	int nrg = atk->nrg, when, at, charge = atk->rules->chargeTime, delay = atk->rules->atkDelay;
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+	const Pokemon *attack = side->mon;
+	const char *atkName = specData[attack->species].name;
+#else
+	(void)now;
+#endif
+	if (type == EVENT_SPECIAL) {
+		// Special! Usually the special can be charged during the previous dodge, but add half
+		// the charge time to make sure
+		when = addEvent(atk, EVENT_NOP, (charge >> 1) + side->window[EVENT_SPECIAL]) +
+			(charge >> 1);
+		at = tl->plan;
+		addEvent(atk, EVENT_SPECIAL, 0);
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+		printf("[ %05d ] %s queued %s at %d\n", now, atkName, moves[attack->powerMove].name,
+			when);
+#endif
+		nrg -= side->powerEnergy;
+	} else {
+		// Basic
+		when = addEvent(atk, EVENT_NOP, side->window[EVENT_BASIC]);
+		at = tl->plan;
+		addEvent(atk, EVENT_BASIC, 0);
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+		printf("[ %05d ] %s queued %s at %d\n", now, atkName, moves[attack->basicMove].name,
+			when);
+#endif
+		nrg += side->basicEnergy;
+		if (nrg > side->nrgMax)
+			nrg = side->nrgMax;
+		if (delay > 0)
+			addEvent(atk, EVENT_NOP, delay);
+	}
+	tl->data[at & TIMELINE_MASK].energy = nrg - atk->nrg;
+	atk->nrg = nrg;
+	return when;
+}
+
+// Store what happened (exclude the Victory! screen delay on principle)
+static inline int battleResult(BattleResult *setup, int et, BattleStatus *atk,
+		BattleStatus *def) {
+	int result, atkHP = atk->side->hp, defHP = def->side->hp;
+	// Display what happened
+#if defined(PRINT_RESULTS) && defined(_DEBUG)
+	printf("-- Battle over (%d.%03d s) --\n", et / 1000, et % 1000);
+	printf(" %s (%d HP) dealt %d damage\n", specData[setup->attacking->species].name, atkHP -
+		atk->damage, def->damage);
+	printf(" %s (%d HP) dealt %d damage\n", specData[setup->defending->species].name, defHP -
+		def->damage, atk->damage);
+#endif
+	setup->timeLeft = atk->rules->maxTime - et;
+	setup->atkDamage = atk->damage;
+	setup->defDamage = def->damage;
+	// Who won?
+	result = 1;
+	if (def->damage < defHP) {
+		if (atk->damage > atkHP)
+			// Ties go to the attacker
+			result = -1;
+		else
+			// Timeouts go to the defender
+			result = 0;
+	}
+#if defined(PRINT_RESULTS) && defined(_DEBUG)
+	if (result > 0)
+		puts("Attacker won!");
+	else
+		puts("Defender won!");
+#endif
+	TRACE_ADD(RECORD_END, TRACE_ATTACKER, EVENT_NOP, et, result, 0);
+	return result;
+}
+
+// Converts a 16-bit random number into a defender delay from 0 to range
+static inline int defenderDelay(int rnd, int range) {
+	//https://www.reddit.com/r/TheSilphRoad/comments/52b453/testing_gym_combat_misconceptions_2/
+	// In integer, convert to (0..1) * range
+	return (rnd * range + 0x7FFF) / 0xFFFF;
+}
+
+// Adds a defender attack (special or basic) followed by a wait of DEF_DELAY + delay
+static inline int defenderQueue(BattleStatus *def, int now, bool special, int delay) {
+	const Combatant *side = def->side;
+	Timeline *tl = def->tl;
+	int nrg = def->nrg, when, at;
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+	const Pokemon *defense = side->mon;
+	const char *defName = specData[defense->species].name;
+#else
+	(void)now;
+#endif
+	if (special) {
+		// Special! Defender does not need to charge, but does wait afterwards
+		when = addEvent(def, EVENT_NOP, side->window[EVENT_SPECIAL]);
+		at = tl->plan;
+		addEvent(def, EVENT_SPECIAL, 0);
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+		printf("[ %05d ] %s queued %s at %d\n", now, defName, moves[defense->powerMove].name,
+			when);
+#endif
+		nrg -= side->powerEnergy;
+	} else {
+		when = addEvent(def, EVENT_NOP, side->window[EVENT_BASIC]);
+		at = tl->plan;
+		addEvent(def, EVENT_BASIC, 0);
+#if defined(PRINT_QUEUES) && defined(_DEBUG)
+		printf("[ %05d ] %s queued %s at %d\n", now, defName, moves[defense->basicMove].name,
+			when);
+#endif
+		nrg += side->basicEnergy;
+		if (nrg > side->nrgMax)
+			nrg = side->nrgMax;
+	}
+	// Delay after
+	//https://www.reddit.com/r/TheSilphRoad/comments/4wzll7/testing_gym_combat_misconceptions
+	addEvent(def, EVENT_NOP, def->rules->defDelay + delay);
+	tl->data[at & TIMELINE_MASK].energy = nrg - def->nrg;
+	def->nrg = nrg;
+	STAT_ADD(defPlans, 1);
+	STAT_QUEUED(def->tl);
+	return when;
+}
+
+// Draws a 16-bit random number for a defender choice
+static inline int defenderDraw(BattleStatus *def, int now) {
+	int rnd = (int)(nextRandom(def->rng) >> 16);
+#ifndef BATTLE_TRACE
+	(void)now;
+#endif
+	TRACE_ADD(RECORD_DRAW, TRACE_DEFENDER, EVENT_NOP, now, rnd, 0);
+	return rnd;
+}
+
+// Adds a defender attack, randomly choosing special if there is enough energy, and a random
+// delay afterwards. Paired battles draw for the special even without the energy, so that every
+// defender attack takes two draws and the same battle meets the same rolls whatever the
+// attacker does; otherwise the draw is skipped, as repeatFight always has
+static inline int defenderAttack(BattleStatus *def, int now, bool paired) {
+	const Rules *rules = def->rules;
+	bool charged = def->nrg > def->side->powerEnergy, special = (charged || paired) &&
+		defenderDraw(def, now) < rules->defProb && charged;
+	return defenderQueue(def, now, special, defenderDelay(defenderDraw(def, now),
+		rules->defDelayRange));
+}
+
+// Prepares the initial fixed defender strategy
+static inline void defenderStart(BattleStatus *def) {
+	int cd = def->side->basicCooldown;
+	clearTimeline(def->tl);
+	// Defender has a fixed initial strategy, which does generate energy!
+	// Starts attack at T=1, starts attack again at T=2 (even if first attack not finished!)
+	addEvent(def, EVENT_NOP, 1000 + cd);
+	addEvent(def, EVENT_BASIC, 0);
+	// 1000 + cd in, need to hit again at 2000 + cd, basic attacks take 0 time
+	addEvent(def, EVENT_NOP, 1000);
+	addEvent(def, EVENT_BASIC, 0);
+	// Third attack was based on a 2s delay after the first one ends (1000+cd), needs to start
+	// at 3000+cd, currently at 2000+cd
+	addEvent(def, EVENT_NOP, 1000);
+	def->nrg = def->side->basicEnergy;
+	TRACE_ADD(RECORD_START, TRACE_DEFENDER, EVENT_NOP, 0, def->side->hp, 0);
+	TRACE_PLANNED(TRACE_DEFENDER, def->tl, 0, def->nrg);
+}
+
+// Executes the head move of the specified timeline, returning the damage it does if not dodged
+static inline int execute(BattleStatus *status, bool dodge) {
+	Timeline *timeline = status->tl;
+	int idx = timeline->exec;
+	FightEvent *evt = &timeline->data[idx & TIMELINE_MASK];
+	// All information is in the damage table, how useful!
+	int damage = status->side->damage[evt->type];
+#if (defined(PRINT_DAMAGE) || defined(PRINT_ALL_ACTIONS)) && defined(_DEBUG)
+	const Pokemon *user = status->side->mon;
+	const char *name = specData[user->species].name;
+	int type = evt->type;
+#endif
+#if defined(PRINT_DAMAGE) && defined(_DEBUG)
+	if (type == EVENT_BASIC || type == EVENT_SPECIAL) {
+		// Prefix the damage notification
+		printf("[ %05d ] ", evt->time);
+		printDamage(status->side->foe, &moves[type == EVENT_BASIC ? user->basicMove :
+			user->powerMove], dodge ? status->side->dodged[type] : damage, dodge);
+	}
+#endif
+#if defined(PRINT_ALL_ACTIONS) && defined(_DEBUG)
+	if (type == EVENT_DODGE)
+		printf("[ %05d ] %s dodged!\n", evt->time, name);
+	else if (type == EVENT_NOP)
+		printf("[ %05d ] %s waits for %d\n", evt->time, name, evt->duration);
+#else
+	(void)dodge;
+#endif
+	timeline->exec = idx + 1;
+	return damage;
+}
+
+// Sets up the policy that plans the same way as a STRAT_x strategy under the given rules
+static FORCE_INLINE void initStrategyPolicy(Policy *policy, int strategy, const Rules *rules) {
+	policy->dodge = 0;
+	if (strategy == STRAT_DODGE_CHARGE)
+		policy->dodge = DODGE_SPECIAL;
+	else if (strategy == STRAT_DODGE_ALL)
+		policy->dodge = DODGE_BASIC | DODGE_SPECIAL;
+	policy->dodgeWait = rules->dodgeWait;
+	policy->maxWeave = MAX_PLAN_ATTACKS;
+	policy->greedy = false;
+}
+
+// Calculates the next attacker plan by a policy
+static FORCE_INLINE void nextPolicyAttack(BattleStatus *atk, BattleStatus *def, int now,
+		const Policy *policy) {
+	const Combatant *side = atk->side;
+	const FightEvent *prevAtk = &atk->tl->lastAttack, *nextDef = planEvent(def->tl);
+	// Find out how much energy is needed and if we, they have power now
+	int attackEnd = prevAtk->time + prevAtk->duration, cutoff = nextDef->time - attackEnd,
+		nextType = nextDef->type, lastType = def->tl->lastAttack.type;
+	bool defHasNRG = def->nrg >= def->side->powerEnergy, atkHasNRG = atk->nrg >=
+		side->powerEnergy, dodged = prevAtk->type == EVENT_DODGE;
+	if (policy->dodge == 0)
+		// Queue one attack always
+		attackerDoAttack(atk, now, atkHasNRG ? EVENT_SPECIAL : EVENT_BASIC);
+	else if (cutoff > 0) {
+		// Calculate how long until next defender attack and how much we can do before then
+		// Subtract one from cutoff to make sure that ties err on the side of caution
+		int rate = side->basicCooldown + atk->rules->atkDelay, qty = (cutoff - 1) / rate,
+			dodgeTime, leftover, flag = (nextType == EVENT_SPECIAL) ? DODGE_SPECIAL :
+			DODGE_BASIC;
+		if (qty > policy->maxWeave)
+			// Wait out the rest
+			qty = policy->maxWeave;
+		leftover = cutoff - (rate * qty);
+		if (atkHasNRG && nextType != EVENT_SPECIAL && (policy->greedy || !defHasNRG ||
+				(dodged && lastType == EVENT_SPECIAL)))
+			// Queue special attack if defender just used its own or cannot use it
+			attackerDoAttack(atk, now, EVENT_SPECIAL);
+		else if (policy->dodge & flag) {
+			// Attack until next defender attack
+			for (int i = 0; i < qty; i++)
+				attackerDoAttack(atk, now, EVENT_BASIC);
+			// Wait until the damage window starts
+			if (leftover > policy->dodgeWait)
+				addEvent(atk, EVENT_NOP, leftover - policy->dodgeWait);
+			// Dodge
+			dodgeTime = attackerDodge(atk);
+#if defined(PRINT_PLAN) && defined(_DEBUG)
+			printf("[ %05d ] Attacking %d times before dodge at %d\n", now, qty, dodgeTime);
+#else
+			(void)dodgeTime;
+#endif
+		} else
+			// Just hit them, use special if they cannot possibly have energy
+			attackerDoAttack(atk, now, (defHasNRG || !atkHasNRG) ? EVENT_BASIC :
+				EVENT_SPECIAL);
+	}
+	STAT_ADD(atkPlans, 1);
+	STAT_QUEUED(atk->tl);
+}
+
+// Calculates the next attacker plan by a STRAT_x strategy, which is a constant policy that
+// folds into the planner
+static FORCE_INLINE void nextAttackerAttack(BattleStatus *atk, BattleStatus *def, int now,
+		int atkStrategy) {
+	Policy policy;
+	initStrategyPolicy(&policy, atkStrategy, atk->rules);
+	nextPolicyAttack(atk, def, now, &policy);
+}
+
+// Executes the next attacker and/or defender events and returns the new time
+static FORCE_INLINE int nextEvents(BattleStatus *atk, BattleStatus *def) {
+	Timeline *atkTL = atk->tl, *defTL = def->tl;
+	const FightEvent *nextAtk = headEvent(atkTL), *nextDef = headEvent(defTL);
+	int nextAT = nextAtk->time, nextDT = nextDef->time, dd, energy,
+		hpToEnergy = atk->rules->hpToEnergy;
+	if (nextDT >= nextAT) {
+		// Move attacker timeline, defender cannot dodge at this time
+		if (nextAtk->type != EVENT_NOP)
+			atkTL->lastAttack = *nextAtk;
+		dd = execute(atk, false);
+		// Every 2 damage done, add NRG
+		energy = def->nrg + (dd + hpToEnergy - 1) / hpToEnergy;
+		if (energy > def->side->nrgMax)
+			energy = def->side->nrgMax;
+		def->nrg = energy;
+		def->damage += dd;
+		TRACE_ADD(RECORD_EXECUTE, TRACE_ATTACKER, nextAtk->type, nextAtk->time, dd,
+			def->damage);
+	}
+	if (nextDT <= nextAT) {
+		bool dodge;
+		int type = nextDef->type;
+		if (type != EVENT_NOP)
+			defTL->lastAttack = *nextDef;
+		// Need to use the previous event as any dodges have been retired!
+		nextAtk = &atkTL->lastAttack;
+		dodge = nextAtk->type == EVENT_DODGE && nextAtk->time + nextAtk->duration > nextDT;
+		dd = execute(def, dodge);
+		// Every 2 damage done, add NRG (rounds up)
+		energy = atk->nrg + (dd + hpToEnergy - 1) / hpToEnergy;
+		if (energy > atk->side->nrgMax)
+			energy = atk->side->nrgMax;
+		atk->nrg = energy;
+		// Move defender timeline
+		nextAT = nextDT;
+		// Dodge damage was worked out with the rest of the damage table
+		if (dodge) {
+			dd = def->side->dodged[type];
+			STAT_ADD(dodgeHits, 1);
+		}
+		atk->damage += dd;
+		TRACE_ADD(dodge ? RECORD_DODGED : RECORD_EXECUTE, TRACE_DEFENDER, type, nextDT, dd,
+			atk->damage);
+	}
+	return nextAT;
+}
+
+// Runs the battle loop from time 0 until a side faints or maxTime is reached, and returns the
+// time it stopped at; the attacker plans by the policy if there is one, or else the strategy,
+// and the defender draws as defenderAttack does for paired battles or not
+static FORCE_INLINE int battleLoop(BattleStatus *atk, BattleStatus *def, int atkStrategy,
+		const Policy *policy, bool paired, int maxTime) {
+	Timeline *atkTL = atk->tl, *defTL = def->tl;
+	int now = 0, atkHP = atk->side->hp, defHP = def->side->hp;
+	while (now < maxTime && atk->damage < atkHP && def->damage < defHP) {
+		// If planned events are exhausted, plan next attack/defense
+		if (defTL->exec >= defTL->plan) {
+			defenderAttack(def, now, paired);
+			TRACE_PLANNED(TRACE_DEFENDER, defTL, now, def->nrg);
+		}
+		if (atkTL->exec >= atkTL->plan) {
+			if (policy != NULL)
+				nextPolicyAttack(atk, def, now, policy);
+			else
+				nextAttackerAttack(atk, def, now, atkStrategy);
+			TRACE_PLANNED(TRACE_ATTACKER, atkTL, now, atk->nrg);
+		}
+		// Advance to the next event
+		now = nextEvents(atk, def);
+	}
+	return now;
+}
@@ -0,0 +1,276 @@
+#include "stdafx.h"
+#include "gamedata.h"
+#include "names.h"
+#include "platform.h"
+
+// Starts every image
+static const char IMAGE_MAGIC[8] = { 'P', 'G', 'S', 'I', 'M', 'A', 'G', 'E' };
+// String offset of a missing name
+#define NO_NAME 0xFFFFFFFFU
+
+// Start of the image; sections are given as byte offsets from the start of the file
+typedef struct _ImageHeader {
+	char magic[8];
+	// IMAGE_VERSION
+	uint32_t version;
+	// Size of the whole file
+	uint32_t size;
+	// FNV-1a hash of everything after the header
+	uint32_t checksum;
+	// MAX_MOVE_INDEX move records, indexed by move number
+	uint32_t numMoves;
+	uint32_t moves;
+	// NUM_SPECIES species records in specData order
+	uint32_t numSpecies;
+	uint32_t species;
+	// Defender and attacker rosters as Pokemon records
+	uint32_t numDefs;
+	uint32_t defs;
+	uint32_t numAtks;
+	uint32_t atks;
+	// NUL terminated names, referenced by offset from the start of this section
+	uint32_t strings;
+	uint32_t stringsSize;
+} ImageHeader;
+
+// Move in the image, the same as Move but with a string offset for the name
+typedef struct _ImageMove {
+	int32_t number;
+	uint32_t name;
+	int32_t power;
+	int32_t type;
+	int32_t energyReq;
+	int32_t energyGen;
+	int32_t cooldown;
+	int32_t window;
+} ImageMove;
+
+// Species in the image, the same as Species but with a string offset for the name
+typedef struct _ImageSpecies {
+	int32_t number;
+	uint32_t name;
+	int32_t hp;
+	int32_t attack;
+	int32_t defense;
+	int32_t type[2];
+	int32_t basic[MAX_BASIC_MOVES];
+	int32_t special[MAX_SPECIAL_MOVES];
+} ImageSpecies;
+
+// Rosters are stored as Pokemon records, which must hold nothing but 32-bit ints
+typedef char IMAGE_POKEMON_CHECK[(sizeof(Pokemon) == 7U * sizeof(int32_t)) ? 1 : -1];
+
+// Mapped image, if one is loaded
+static MappedFile image;
+
+// Calculates the FNV-1a hash of a block of data
+static uint32_t imageChecksum(const unsigned char *data, size_t size) {
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ (uint32_t)data[i]) * 16777619U;
+	return hash;
+}
+
+// Reports true if count records of the given size at offset fit in the image and are aligned
+static bool validSection(const ImageHeader *header, uint32_t offset, uint32_t count,
+		size_t size) {
+	return (offset & 3U) == 0U && offset >= sizeof(ImageHeader) && offset <= header->size &&
+		(uint64_t)count * (uint64_t)size <= (uint64_t)(header->size - offset);
+}
+
+// Reports true if every pokemon of a roster has a known species and moves, and a level and IVs
+// inside the tables, so that none of them can index past the end of one
+static bool validRoster(const Pokemon *mons, int count) {
+	bool ok = true;
+	for (int i = 0; i < count && ok; i++) {
+		const Pokemon *mon = &mons[i];
+		ok = mon->species >= 0 && mon->species < NUM_SPECIES && mon->basicMove >= 0 &&
+			mon->basicMove < MAX_MOVE_INDEX && moves[mon->basicMove].name != NULL &&
+			mon->powerMove >= 0 && mon->powerMove < MAX_MOVE_INDEX &&
+			moves[mon->powerMove].name != NULL && mon->level >= 0 && mon->level < NUM_LEVELS &&
+			mon->ivAttack >= 0 && mon->ivAttack < NUM_IVS && mon->ivDefense >= 0 &&
+			mon->ivDefense < NUM_IVS && mon->ivHP >= 0 && mon->ivHP < NUM_IVS;
+	}
+	return ok;
+}
+
+// Releases the loaded image, if any (call before destroyAll)
+void closeImage() {
+	if (image.data != NULL) {
+		// Names point into the image
+		destroyNames();
+		for (int i = 0; i < MAX_MOVE_INDEX; i++)
+			moves[i].name = NULL;
+		for (int i = 0; i < NUM_SPECIES; i++)
+			specData[i].name = NULL;
+		unmapFile(&image);
+	}
+}
+
+// Checks that every part of a mapped image is in bounds, returning the header if it is valid
+static const ImageHeader * checkImage(const MappedFile *map) {
+	const ImageHeader *header = (const ImageHeader *)map->data;
+	const unsigned char *data = (const unsigned char *)map->data;
+	bool ok = map->size >= sizeof(ImageHeader) && memcmp(header->magic, IMAGE_MAGIC,
+		sizeof(IMAGE_MAGIC)) == 0 && header->version == IMAGE_VERSION && header->size ==
+		map->size && header->numMoves == MAX_MOVE_INDEX && header->numSpecies == NUM_SPECIES;
+	ok = ok && validSection(header, header->moves, header->numMoves, sizeof(ImageMove)) &&
+		validSection(header, header->species, header->numSpecies, sizeof(ImageSpecies)) &&
+		validSection(header, header->defs, header->numDefs, sizeof(Pokemon)) &&
+		validSection(header, header->atks, header->numAtks, sizeof(Pokemon)) &&
+		validSection(header, header->strings, header->stringsSize, 1U);
+	// Every name must end inside the string table
+	ok = ok && header->stringsSize > 0U && data[header->strings + header->stringsSize - 1U] ==
+		'\0' && imageChecksum(&data[sizeof(ImageHeader)], map->size - sizeof(ImageHeader)) ==
+		header->checksum;
+	if (ok) {
+		const ImageMove *mv = (const ImageMove *)&data[header->moves];
+		const ImageSpecies *spec = (const ImageSpecies *)&data[header->species];
+		for (uint32_t i = 0; i < header->numMoves && ok; i++)
+			ok = mv[i].name == NO_NAME || mv[i].name < header->stringsSize;
+		for (uint32_t i = 0; i < header->numSpecies && ok; i++)
+			ok = spec[i].name == NO_NAME || spec[i].name < header->stringsSize;
+	}
+	return ok ? header : NULL;
+}
+
+// Maps an image file, loads the moves and species from it and copies both rosters to a new
+// array in *mons (freeing the old one), the defenders followed by the attackers; returns false
+// if the image is missing or not valid
+bool loadImage(const char *fileName, Pokemon **mons, int *numDefs, int *numAtks) {
+	const ImageHeader *header;
+	bool ok = false;
+	closeImage();
+	if (mapFile(&image, fileName) && (header = checkImage(&image)) != NULL) {
+		const unsigned char *data = (const unsigned char *)image.data;
+		const ImageMove *mv = (const ImageMove *)&data[header->moves];
+		const ImageSpecies *spec = (const ImageSpecies *)&data[header->species];
+		const char *strings = (const char *)&data[header->strings];
+		for (int i = 0; i < MAX_MOVE_INDEX; i++, mv++) {
+			Move *move = &moves[i];
+			move->number = mv->number;
+			move->name = (mv->name == NO_NAME) ? NULL : (char *)&strings[mv->name];
+			move->power = mv->power;
+			move->type = mv->type;
+			move->energyReq = mv->energyReq;
+			move->energyGen = mv->energyGen;
+			move->cooldown = mv->cooldown;
+			move->window = mv->window;
+		}
+		for (int i = 0; i < NUM_SPECIES; i++, spec++) {
+			Species *mon = &specData[i];
+			mon->number = spec->number;
+			mon->name = (spec->name == NO_NAME) ? NULL : (char *)&strings[spec->name];
+			mon->hp = spec->hp;
+			mon->attack = spec->attack;
+			mon->defense = spec->defense;
+			mon->type[0] = spec->type[0];
+			mon->type[1] = spec->type[1];
+			memcpy(mon->basic, spec->basic, sizeof(mon->basic));
+			memcpy(mon->special, spec->special, sizeof(mon->special));
+		}
+		// Rosters were looked up when the image was made, but are checked against the moves
+		// and species they index (one spare record, so that empty rosters still allocate)
+		Pokemon *roster = (Pokemon *)malloc(sizeof(Pokemon) * ((size_t)header->numDefs +
+			(size_t)header->numAtks + 1U));
+		*numDefs = (int)header->numDefs;
+		*numAtks = (int)header->numAtks;
+		if (roster != NULL) {
+			memcpy(roster, &data[header->defs], sizeof(Pokemon) * (size_t)*numDefs);
+			memcpy(&roster[*numDefs], &data[header->atks], sizeof(Pokemon) * (size_t)*numAtks);
+			free(*mons);
+			*mons = roster;
+			ok = validRoster(roster, *numDefs + *numAtks) && indexNames();
+		}
+		if (!ok)
+			closeImage();
+	} else if (image.data != NULL)
+		unmapFile(&image);
+	return ok;
+}
+
+// Writes the loaded moves and species and the two rosters to an image file; returns false if
+// the file could not be written
+bool writeImage(const char *fileName, const Pokemon *defs, int numDefs, const Pokemon *atks,
+		int numAtks) {
+	ImageHeader header;
+	uint32_t stringsSize = 0U, offset;
+	unsigned char *data;
+	FILE *fh;
+	bool ok = false;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+	header.version = IMAGE_VERSION;
+	// Lay out the sections
+	for (int i = 0; i < MAX_MOVE_INDEX; i++)
+		if (moves[i].name != NULL)
+			stringsSize += (uint32_t)strlen(moves[i].name) + 1U;
+	for (int i = 0; i < NUM_SPECIES; i++)
+		if (specData[i].name != NULL)
+			stringsSize += (uint32_t)strlen(specData[i].name) + 1U;
+	header.numMoves = MAX_MOVE_INDEX;
+	header.moves = (uint32_t)sizeof(ImageHeader);
+	header.numSpecies = NUM_SPECIES;
+	header.species = header.moves + header.numMoves * (uint32_t)sizeof(ImageMove);
+	header.numDefs = (uint32_t)numDefs;
+	header.defs = header.species + header.numSpecies * (uint32_t)sizeof(ImageSpecies);
+	header.numAtks = (uint32_t)numAtks;
+	header.atks = header.defs + header.numDefs * (uint32_t)sizeof(Pokemon);
+	header.strings = header.atks + header.numAtks * (uint32_t)sizeof(Pokemon);
+	// Never empty, so that the last byte is always a terminator
+	header.stringsSize = stringsSize + 1U;
+	header.size = header.strings + header.stringsSize;
+	data = (unsigned char *)calloc(header.size, 1U);
+	if (data != NULL) {
+		ImageMove *mv = (ImageMove *)&data[header.moves];
+		ImageSpecies *spec = (ImageSpecies *)&data[header.species];
+		char *strings = (char *)&data[header.strings];
+		offset = 0U;
+		for (int i = 0; i < MAX_MOVE_INDEX; i++, mv++) {
+			const Move *move = &moves[i];
+			mv->number = move->number;
+			mv->name = NO_NAME;
+			if (move->name != NULL) {
+				size_t len = strlen(move->name) + 1U;
+				memcpy(&strings[offset], move->name, len);
+				mv->name = offset;
+				offset += (uint32_t)len;
+			}
+			mv->power = move->power;
+			mv->type = move->type;
+			mv->energyReq = move->energyReq;
+			mv->energyGen = move->energyGen;
+			mv->cooldown = move->cooldown;
+			mv->window = move->window;
+		}
+		for (int i = 0; i < NUM_SPECIES; i++, spec++) {
+			const Species *mon = &specData[i];
+			spec->number = mon->number;
+			spec->name = NO_NAME;
+			if (mon->name != NULL) {
+				size_t len = strlen(mon->name) + 1U;
+				memcpy(&strings[offset], mon->name, len);
+				spec->name = offset;
+				offset += (uint32_t)len;
+			}
+			spec->hp = mon->hp;
+			spec->attack = mon->attack;
+			spec->defense = mon->defense;
+			spec->type[0] = mon->type[0];
+			spec->type[1] = mon->type[1];
+			memcpy(spec->basic, mon->basic, sizeof(spec->basic));
+			memcpy(spec->special, mon->special, sizeof(spec->special));
+		}
+		memcpy(&data[header.defs], defs, sizeof(Pokemon) * (size_t)numDefs);
+		memcpy(&data[header.atks], atks, sizeof(Pokemon) * (size_t)numAtks);
+		header.checksum = imageChecksum(&data[sizeof(ImageHeader)], header.size -
+			sizeof(ImageHeader));
+		memcpy(data, &header, sizeof(header));
+		if (fopen_s(&fh, fileName, "wb") == 0 && fh != NULL) {
+			ok = fwrite(data, header.size, 1, fh) == 1;
+			ok = fclose(fh) == 0 && ok;
+		}
+		free(data);
+	}
+	return ok;
+}
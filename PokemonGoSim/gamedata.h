@@ -0,0 +1,20 @@
+#pragma once
+
+// Game data image: the moves, species and both rosters compiled into one versioned,
+// checksummed file which is mapped into memory and used without any parsing
+
+#include "pokemon.h"
+
+// Change whenever the image layout changes
+#define IMAGE_VERSION 2
+
+// Releases the loaded image, if any (call before destroyAll)
+void closeImage();
+// Maps an image file, loads the moves and species from it and copies both rosters to a new
+// array in *mons (freeing the old one), the defenders followed by the attackers; returns false
+// if the image is missing or not valid
+bool loadImage(const char *fileName, Pokemon **mons, int *numDefs, int *numAtks);
+// Writes the loaded moves and species and the two rosters to an image file; returns false if
+// the file could not be written
+bool writeImage(const char *fileName, const Pokemon *defs, int numDefs, const Pokemon *atks,
+	int numAtks);
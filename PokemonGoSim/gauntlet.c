@@ -0,0 +1,161 @@
+#include "stdafx.h"
+#include "engine.h"
+#include "gauntlet.h"
+
+// Sets up the matchups of a team (fighting in order) against a gym (defending in order)
+void initGauntlet(Gauntlet *gauntlet, const Pokemon *team, int teamSize, const Pokemon *gym,
+		int gymSize) {
+	gauntlet->teamSize = teamSize;
+	gauntlet->gymSize = gymSize;
+	for (int a = 0; a < teamSize; a++)
+		for (int d = 0; d < gymSize; d++)
+			initMatchup(&gauntlet->ctx[a][d], &team[a], &gym[d]);
+}
+
+// Takes back the energy that the events planned but not executed gained or spent, as the
+// timeline is about to be cleared
+static inline void refundTimeline(BattleStatus *stat) {
+	const Timeline *tl = stat->tl;
+	int nrg = stat->nrg, nrgMax = stat->side->nrgMax;
+	for (int i = tl->exec; i < tl->plan; i++)
+		nrg -= tl->data[i & TIMELINE_MASK].energy;
+	// Gains since the plan were capped at the maximum, so the refund can overshoot
+	if (nrg < 0)
+		nrg = 0;
+	else if (nrg > nrgMax)
+		nrg = nrgMax;
+	stat->nrg = nrg;
+}
+
+// Runs one gauntlet under the given rules and adds it to the totals. Each defender gets a
+// fresh battle clock, which keeps running when a fainted attacker is replaced; the survivor
+// of each fight carries its damage and energy into the next one, with a clear timeline and
+// the energy of the moves it had planned but not made taken back
+static FORCE_INLINE void doGauntlet(GauntletResult *totals, const Gauntlet *g,
+		const Rules *rules, int strategy, Timeline *atkTL, Timeline *defTL, Random *rng) {
+	BattleStatus atk, def;
+	int a = 0, d = 0, clock = 0, maxTime = rules->maxTime;
+	clearTimeline(atkTL);
+	initBattle(&atk, &g->ctx[0][0].atk, rules, atkTL, NULL);
+	initBattle(&def, &g->ctx[0][0].def, rules, defTL, rng);
+	defenderStart(&def);
+	while (a < g->teamSize && d < g->gymSize && clock < maxTime) {
+		int now = battleLoop(&atk, &def, strategy, NULL, false, maxTime - clock);
+		bool fresh = false;
+		STAT_BATTLE(atkTL, defTL, now);
+		clock += now;
+		if (def.damage >= def.side->hp) {
+			// Ties go to the attacker, as in battleResult
+			d++;
+			clock = 0;
+			refundTimeline(&atk);
+			if (d < g->gymSize) {
+				initBattle(&def, &g->ctx[a][d].def, rules, defTL, rng);
+				defenderStart(&def);
+				atk.side = &g->ctx[a][d].atk;
+				fresh = true;
+			}
+			clearTimeline(atkTL);
+		}
+		if (atk.damage >= atk.side->hp) {
+			a++;
+			if (a < g->teamSize && d < g->gymSize) {
+				initBattle(&atk, &g->ctx[a][d].atk, rules, atkTL, NULL);
+				def.side = &g->ctx[a][d].def;
+				// A new defender keeps its opening moves
+				if (!fresh) {
+					refundTimeline(&def);
+					clearTimeline(defTL);
+				}
+			}
+			clearTimeline(atkTL);
+		}
+	}
+	totals->ntimes++;
+	if (d >= g->gymSize)
+		totals->wins++;
+	totals->losses += a;
+	totals->beaten += d;
+}
+
+// Runs gauntlets first .. first + count - 1 under the given rules and adds them to the totals
+static FORCE_INLINE void runGauntlets(GauntletResult *totals, const Gauntlet *g,
+		const Rules *rules, int strategy, int first, int count, uint64_t seed) {
+	Timeline atkTL, defTL;
+	Random rng;
+	for (int i = first; i < first + count; i++) {
+		// Each gauntlet has its own stream, as in runBattles
+		seedRandom(&rng, seed, (uint64_t)i);
+		doGauntlet(totals, g, rules, strategy, &atkTL, &defTL, &rng);
+	}
+}
+
+// Runs gauntlets, the specialized kernels ignoring the strategy argument in favor of the one
+// they were compiled for
+typedef void (*GauntletKernel)(GauntletResult *totals, const Gauntlet *g, int strategy,
+	int first, int count, uint64_t seed);
+
+// runGauntlets for STRAT_NO_DODGE and DEFAULT_RULES
+static void gauntletNoDodge(GauntletResult *totals, const Gauntlet *g, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runGauntlets(totals, g, &DEFAULT_RULES, STRAT_NO_DODGE, first, count, seed);
+}
+
+// runGauntlets for STRAT_DODGE_CHARGE and DEFAULT_RULES
+static void gauntletDodgeCharge(GauntletResult *totals, const Gauntlet *g, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runGauntlets(totals, g, &DEFAULT_RULES, STRAT_DODGE_CHARGE, first, count, seed);
+}
+
+// runGauntlets for STRAT_DODGE_ALL and DEFAULT_RULES
+static void gauntletDodgeAll(GauntletResult *totals, const Gauntlet *g, int strategy,
+		int first, int count, uint64_t seed) {
+	(void)strategy;
+	runGauntlets(totals, g, &DEFAULT_RULES, STRAT_DODGE_ALL, first, count, seed);
+}
+
+// runGauntlets for any strategy under the rules the gauntlet was set up with
+static void gauntletAnyRules(GauntletResult *totals, const Gauntlet *g, int strategy,
+		int first, int count, uint64_t seed) {
+	runGauntlets(totals, g, g->ctx[0][0].rules, strategy, first, count, seed);
+}
+
+// Gauntlet loop for each STRAT_x with the default rules folded in, as for the battle kernels
+static const GauntletKernel GAUNTLET_KERNELS[] = { gauntletNoDodge, gauntletDodgeCharge,
+	gauntletDodgeAll };
+
+// Works out the rates and averages of a result from its totals
+static void storeGauntlets(GauntletResult *result) {
+	double nd = (double)result->ntimes, p;
+	result->winRate = (double)result->wins / nd;
+	// Agresti-Coull interval, as in storeTotals
+	p = ((double)result->wins + 2.0) / (nd + 4.0);
+	result->winError = CONFIDENCE_Z * sqrt(p * (1.0 - p) / (nd + 4.0));
+	result->avgLosses = (double)result->losses / nd;
+	result->avgBeaten = (double)result->beaten / nd;
+}
+
+// Adds the gauntlets of one result to another
+void addGauntlets(GauntletResult *totals, const GauntletResult *part) {
+	if (part->ntimes > 0) {
+		totals->ntimes += part->ntimes;
+		totals->wins += part->wins;
+		totals->losses += part->losses;
+		totals->beaten += part->beaten;
+		storeGauntlets(totals);
+	}
+}
+
+// Runs gauntlets first .. first + n - 1, so that a run split into ranges adds up to the same
+// result; the same seed gives the same results
+void repeatGauntlet(GauntletResult *result, const Gauntlet *gauntlet, int first, int n,
+		int strategy, uint64_t seed) {
+	memset(result, 0, sizeof(GauntletResult));
+	if (n > 0 && gauntlet->teamSize > 0 && gauntlet->gymSize > 0) {
+		(isDefaultRules(gauntlet->ctx[0][0].rules) ? GAUNTLET_KERNELS[strategy] :
+			gauntletAnyRules)(result, gauntlet, strategy, first, n, seed);
+		storeGauntlets(result);
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Gym gauntlets: a team of attackers fights its way through a gym of defenders in order, each
+// pokemon keeping its damage and energy until it faints
+
+#include "battle.h"
+
+// Most attackers in a team
+#define MAX_TEAM 6
+// Most defenders in a gym
+#define MAX_GYM 10
+
+// Summary of many gauntlets of one team against one gym
+typedef struct _GauntletResult {
+	// Gauntlets run
+	int ntimes;
+	// Gauntlets that took down every defender
+	int wins;
+	// Attackers fainted and defenders beaten over all the gauntlets
+	long long losses;
+	long long beaten;
+	// Win rate and its 95% confidence interval half width
+	double winRate;
+	double winError;
+	// Average attackers fainted, and defenders beaten
+	double avgLosses;
+	double avgBeaten;
+} GauntletResult;
+
+// Every matchup of a team against a gym, built once so that gauntlets only run battle loops
+typedef struct _Gauntlet {
+	// Contexts indexed by [attacker][defender]
+	MatchupContext ctx[MAX_TEAM][MAX_GYM];
+	int teamSize;
+	int gymSize;
+} Gauntlet;
+
+// Sets up the matchups of a team (fighting in order) against a gym (defending in order)
+void initGauntlet(Gauntlet *gauntlet, const Pokemon *team, int teamSize, const Pokemon *gym,
+	int gymSize);
+// Adds the gauntlets of one result to another
+void addGauntlets(GauntletResult *totals, const GauntletResult *part);
+// Runs gauntlets first .. first + n - 1, so that a run split into ranges adds up to the same
+// result; the same seed gives the same results
+void repeatGauntlet(GauntletResult *result, const Gauntlet *gauntlet, int first, int n,
+	int strategy, uint64_t seed);
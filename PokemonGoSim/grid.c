@@ -0,0 +1,124 @@
+#include "stdafx.h"
+#include "grid.h"
+
+// Longest rule name in a grid file
+#define GRID_NAME_MAX 32U
+
+// Gets the value of one rule at a grid point (the first rule changes slowest)
+double gridValue(const RuleGrid *grid, int point, int axis) {
+	for (int i = grid->numAxes - 1; i > axis; i--)
+		point /= grid->count[i];
+	return grid->from[axis] + grid->step[axis] * (double)(point % grid->count[axis]);
+}
+
+// Fills rules with battleRules changed to the values of a grid point
+void gridRules(const RuleGrid *grid, int point, Rules *rules) {
+	*rules = battleRules;
+	// readRuleGrid checked both ends of every range
+	for (int i = 0; i < grid->numAxes; i++)
+		setRule(rules, grid->rule[i], gridValue(grid, point, i));
+}
+
+// Adds a "NAME from to step" range to a grid; returns false if it is not valid
+static bool addAxis(RuleGrid *grid, const char *name, double from, double to, double step) {
+	int rule = findRule(name), axis = grid->numAxes;
+	// Both ends are tried on a scratch copy, so that range errors show up before the sweep
+	Rules check = battleRules;
+	bool ok = rule >= 0 && axis < MAX_GRID_AXES && step > 0.0 && to >= from &&
+		setRule(&check, rule, from) && setRule(&check, rule, to);
+	if (ok) {
+		// Allow for rounding in the step so that "to" is included
+		int count = (int)floor((to - from) / step + 1e-9) + 1;
+		ok = (double)grid->numPoints * (double)count <= (double)MAX_GRID_POINTS;
+		if (ok) {
+			grid->rule[axis] = rule;
+			grid->from[axis] = from;
+			grid->step[axis] = step;
+			grid->count[axis] = count;
+			grid->numAxes = axis + 1;
+			grid->numPoints *= count;
+		}
+	}
+	if (!ok)
+		printf("Bad grid range: %s %g %g %g\n", name, from, to, step);
+	return ok;
+}
+
+// Reads "NAME from to step" lines (NAME being a constant from pokemon.h) from a grid file;
+// returns false if the file is missing or not valid
+bool readRuleGrid(RuleGrid *grid, const char *fileName) {
+	FILE *fh;
+	bool ok = false;
+	grid->numAxes = 0;
+	grid->numPoints = 1;
+	if (fopen_s(&fh, fileName, "r") == 0 && fh != NULL) {
+		char name[GRID_NAME_MAX];
+		double from, to, step;
+		int read;
+		ok = true;
+		while (ok && 4 == (read = fscanf_s(fh, "%31s %lf %lf %lf ", name, GRID_NAME_MAX,
+				&from, &to, &step)))
+			ok = addAxis(grid, name, from, to, step);
+		// Anything left over is not a range
+		ok = ok && read == EOF && grid->numAxes > 0;
+		fclose(fh);
+	}
+	if (!ok)
+		printf("Failed to load rule grid from %s!\n", fileName);
+	return ok;
+}
+
+// Writes the lines of one grid point and strategy
+static bool writePoint(const GridTable *table, FILE *fh, int point, int s) {
+	const RuleGrid *grid = table->grid;
+	int na = table->numAttackers, nd = table->numDefenders;
+	const RepeatBattleResult *results = &table->results[(point * table->numStrategies + s) *
+		nd * na];
+	bool ok = true;
+	for (int a = 0; a < na && ok; a++) {
+		const Pokemon *mon = &table->attackers[a];
+		double winRate = 0.0, damage = 0.0, otherWins, otherDamage;
+		int rank = 1;
+		for (int d = 0; d < nd; d++) {
+			winRate += results[d * na + a].winRate;
+			damage += results[d * na + a].avgAtkDamage;
+		}
+		// Rank 1 wins the most, then takes the least damage; exact ties share the better rank
+		for (int b = 0; b < na; b++) {
+			otherWins = 0.0;
+			otherDamage = 0.0;
+			for (int d = 0; d < nd; d++) {
+				otherWins += results[d * na + b].winRate;
+				otherDamage += results[d * na + b].avgAtkDamage;
+			}
+			if (otherWins > winRate || (otherWins == winRate && otherDamage < damage))
+				rank++;
+		}
+		for (int i = 0; i < grid->numAxes; i++)
+			fprintf(fh, "%g,", gridValue(grid, point, i));
+		ok = fprintf(fh, "%d,%s,%s,%s,%.5f,%.2f,%d\n", table->strategies[s],
+			specData[mon->species].name, moves[mon->basicMove].name,
+			moves[mon->powerMove].name, winRate / (double)nd, damage / (double)nd, rank) > 0;
+	}
+	return ok;
+}
+
+// Writes the table as CSV, one line per grid point, strategy and attacker, with the results
+// averaged over the defenders and the attackers ranked by win rate within each point; returns
+// false if the file could not be written
+bool writeGridTable(const GridTable *table, const char *fileName) {
+	const RuleGrid *grid = table->grid;
+	FILE *fh;
+	bool ok = false;
+	if (fopen_s(&fh, fileName, "w") == 0 && fh != NULL) {
+		for (int i = 0; i < grid->numAxes; i++)
+			fprintf(fh, "%s,", ruleName(grid->rule[i]));
+		ok = fputs("Strategy,Attacker,Attacker Basic,Attacker Charge,Win Rate,"
+			"Attacker Damage,Rank\n", fh) >= 0;
+		for (int p = 0; p < grid->numPoints && ok; p++)
+			for (int s = 0; s < table->numStrategies && ok; s++)
+				ok = writePoint(table, fh, p, s);
+		ok = fclose(fh) == 0 && ok;
+	}
+	return ok;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Sweeps of the battle rules over a grid of values, one matchup set per grid point, written
+// out as one table
+
+#include "pokemon.h"
+#include "rules.h"
+
+// Most rules that one grid varies
+#define MAX_GRID_AXES 4
+// Most points in one grid
+#define MAX_GRID_POINTS 4096
+
+// Values to try for each varied rule; every combination is one grid point
+typedef struct _RuleGrid {
+	// Rules varied, as found by findRule
+	int rule[MAX_GRID_AXES];
+	// First value and step of each rule
+	double from[MAX_GRID_AXES];
+	double step[MAX_GRID_AXES];
+	// Number of values of each rule
+	int count[MAX_GRID_AXES];
+	int numAxes;
+	// Product of the counts
+	int numPoints;
+} RuleGrid;
+
+// Results of a grid sweep: one matchup set per grid point
+typedef struct _GridTable {
+	// Grid swept
+	const RuleGrid *grid;
+	// Results, indexed by [point][strategy][defender][attacker]
+	const RepeatBattleResult *results;
+	// STRAT_x of each strategy
+	const int *strategies;
+	int numStrategies;
+	// Attacking pokemon
+	const Pokemon *attackers;
+	int numAttackers;
+	// Number of defending pokemon
+	int numDefenders;
+} GridTable;
+
+// Gets the value of one rule at a grid point (the first rule changes slowest)
+double gridValue(const RuleGrid *grid, int point, int axis);
+// Fills rules with battleRules changed to the values of a grid point
+void gridRules(const RuleGrid *grid, int point, Rules *rules);
+// Reads "NAME from to step" lines (NAME being a constant from pokemon.h) from a grid file;
+// returns false if the file is missing or not valid
+bool readRuleGrid(RuleGrid *grid, const char *fileName);
+// Writes the table as CSV, one line per grid point, strategy and attacker, with the results
+// averaged over the defenders and the attackers ranked by win rate within each point; returns
+// false if the file could not be written
+bool writeGridTable(const GridTable *table, const char *fileName);
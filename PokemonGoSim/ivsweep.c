@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "ivsweep.h"
+#include "rules.h"
+
+// Distinct pokemon that an IV sweep starts with room for
+#define IV_START_DISTINCT 1024
+
+// Column names of an IV table, which has one variant per line
+const char IV_TABLE_HEADER[] = "Strategy,Attacker,Attacker Basic,Attacker Charge,Level,"
+	"Attack IV,Defense IV,HP IV,CP,HP,Win Rate,Attacker Damage\n";
+
+// Numbers each IV by the lowest IV whose row of values (width per IV) is the same
+static void groupIVs(int group[NUM_IVS], const int *values, int width) {
+	for (int iv = 0; iv < NUM_IVS; iv++) {
+		group[iv] = iv;
+		for (int other = 0; other < iv && group[iv] == iv; other++)
+			if (memcmp(&values[iv * width], &values[other * width], sizeof(int) *
+					(size_t)width) == 0)
+				group[iv] = other;
+	}
+}
+
+// Adds a distinct pokemon, growing the array if it is full; returns its index, or -1 if out
+// of memory
+static int addDistinct(IvSweep *ivs, int *capacity, const Pokemon *mon) {
+	int index = -1;
+	if (ivs->numDistinct == *capacity) {
+		Pokemon *more = (Pokemon *)realloc(ivs->distinct, sizeof(Pokemon) * (size_t)*capacity *
+			2U);
+		if (more != NULL) {
+			ivs->distinct = more;
+			*capacity *= 2;
+		}
+	}
+	if (ivs->numDistinct < *capacity) {
+		index = ivs->numDistinct++;
+		ivs->distinct[index] = *mon;
+	}
+	return index;
+}
+
+// Averages the win rate and damage to the attacker of one distinct pokemon over the defenders
+static void averageResults(const RepeatBattleResult *results, int numDistinct, int distinct,
+		int numDefenders, double *winRate, double *damage) {
+	*winRate = 0.0;
+	*damage = 0.0;
+	for (int d = 0; d < numDefenders; d++) {
+		const RepeatBattleResult *result = &results[d * numDistinct + distinct];
+		*winRate += result->winRate;
+		*damage += result->avgAtkDamage;
+	}
+	*winRate /= (double)numDefenders;
+	*damage /= (double)numDefenders;
+}
+
+// Releases the pokemon and variants of an IV sweep
+void destroyIvSweep(IvSweep *ivs) {
+	free(ivs->distinct);
+	free(ivs->levelStart);
+	free(ivs->variant);
+	ivs->distinct = NULL;
+	ivs->levelStart = NULL;
+	ivs->variant = NULL;
+	ivs->numDistinct = 0;
+}
+
+// Groups the IVs of the pokemon at each level of minLevel .. maxLevel (CPM indexes) by the HP,
+// the damage done to each defender and the damage taken from each defender that they give;
+// variants that agree on all of them fight exactly the same battles. Returns false if out of
+// memory
+bool initIvSweep(IvSweep *ivs, const Pokemon *base, const Pokemon *defenders, int numDefenders,
+		int minLevel, int maxLevel) {
+	int levels = maxLevel - minLevel + 1, width = 2 * numDefenders, capacity = IV_START_DISTINCT;
+	// Damage done by both moves to each defender by attack IV, and taken by defense IV
+	int *dealt = (int *)malloc(sizeof(int) * NUM_IVS * (size_t)width), *taken = (int *)malloc(
+		sizeof(int) * NUM_IVS * (size_t)width);
+	bool ok;
+	ivs->base = *base;
+	ivs->minLevel = minLevel;
+	ivs->maxLevel = maxLevel;
+	ivs->numDistinct = 0;
+	ivs->distinct = (Pokemon *)malloc(sizeof(Pokemon) * (size_t)capacity);
+	ivs->levelStart = (int *)malloc(sizeof(int) * (size_t)(levels + 1));
+	ivs->variant = (int *)malloc(sizeof(int) * NUM_IV_COMBOS * (size_t)levels);
+	ok = dealt != NULL && taken != NULL && ivs->distinct != NULL && ivs->levelStart != NULL &&
+		ivs->variant != NULL;
+	for (int l = 0; l < levels && ok; l++) {
+		Pokemon mon = *base;
+		int hp[NUM_IVS], damage[NUM_IVS], hpGroup[NUM_IVS], atkGroup[NUM_IVS],
+			defGroup[NUM_IVS], slot[NUM_IV_COMBOS], *variant = &ivs->variant[l * NUM_IV_COMBOS];
+		mon.level = minLevel + l;
+		getHPs(hp, &mon);
+		for (int d = 0; d < numDefenders; d++) {
+			const Pokemon *foe = &defenders[d];
+			// Each column gets one move against one defender for every IV at once
+			for (int m = 0; m < 2; m++) {
+				int col = 2 * d + m;
+				getRulesDamages(damage, &mon, foe, &moves[(m == 0) ? mon.basicMove :
+					mon.powerMove], &battleRules, false);
+				for (int iv = 0; iv < NUM_IVS; iv++)
+					dealt[iv * width + col] = damage[iv];
+				getRulesDamages(damage, foe, &mon, &moves[(m == 0) ? foe->basicMove :
+					foe->powerMove], &battleRules, true);
+				for (int iv = 0; iv < NUM_IVS; iv++)
+					taken[iv * width + col] = damage[iv];
+			}
+		}
+		groupIVs(hpGroup, hp, 1);
+		groupIVs(atkGroup, dealt, width);
+		groupIVs(defGroup, taken, width);
+		ivs->levelStart[l] = ivs->numDistinct;
+		for (int i = 0; i < NUM_IV_COMBOS; i++)
+			slot[i] = -1;
+		for (int a = 0; a < NUM_IVS && ok; a++)
+			for (int d = 0; d < NUM_IVS && ok; d++)
+				for (int h = 0; h < NUM_IVS && ok; h++) {
+					int key = (atkGroup[a] * NUM_IVS + defGroup[d]) * NUM_IVS + hpGroup[h];
+					if (slot[key] < 0) {
+						// First of its group, which stands in for the rest
+						mon.ivAttack = atkGroup[a];
+						mon.ivDefense = defGroup[d];
+						mon.ivHP = hpGroup[h];
+						slot[key] = addDistinct(ivs, &capacity, &mon);
+						ok = slot[key] >= 0;
+					}
+					variant[(a * NUM_IVS + d) * NUM_IVS + h] = slot[key];
+				}
+	}
+	if (ok)
+		ivs->levelStart[levels] = ivs->numDistinct;
+	else
+		destroyIvSweep(ivs);
+	free(taken);
+	free(dealt);
+	return ok;
+}
+
+// Prints the number of distinct variants and the spread of the win rates at each level, from
+// the results of one strategy indexed [defender][distinct]
+void printIvLevels(const IvSweep *ivs, const RepeatBattleResult *results, int numDefenders) {
+	for (int l = 0; l <= ivs->maxLevel - ivs->minLevel; l++) {
+		const int *variant = &ivs->variant[l * NUM_IV_COMBOS];
+		double low = 1.0, high = 0.0, total = 0.0, winRate, damage;
+		for (int i = 0; i < NUM_IV_COMBOS; i++) {
+			averageResults(results, ivs->numDistinct, variant[i], numDefenders, &winRate,
+				&damage);
+			total += winRate;
+			if (winRate < low)
+				low = winRate;
+			if (winRate > high)
+				high = winRate;
+		}
+		printf("L%4.1f: %4d distinct, win rate %5.1f%% to %5.1f%% (%5.1f%% average)\n",
+			(double)(ivs->minLevel + l + 1) * 0.5, ivs->levelStart[l + 1] -
+			ivs->levelStart[l], 100.0 * low, 100.0 * high, 100.0 * total / NUM_IV_COMBOS);
+	}
+}
+
+// Writes every variant as lines of an IV table with its results averaged over the defenders,
+// from the results indexed [strategy][defender][distinct]; returns false if it could not be
+// written
+bool writeIvTable(FILE *fh, const IvSweep *ivs, const RepeatBattleResult *results,
+		const int *strategies, int numStrategies, int numDefenders) {
+	const Pokemon *base = &ivs->base;
+	bool ok = true;
+	for (int s = 0; s < numStrategies && ok; s++)
+		for (int l = 0; l <= ivs->maxLevel - ivs->minLevel && ok; l++) {
+			Pokemon mon = *base;
+			int cp[NUM_IV_COMBOS], hp[NUM_IVS];
+			const int *variant = &ivs->variant[l * NUM_IV_COMBOS];
+			mon.level = ivs->minLevel + l;
+			getCPs(cp, &mon);
+			getHPs(hp, &mon);
+			for (int i = 0; i < NUM_IV_COMBOS && ok; i++) {
+				double winRate, damage;
+				averageResults(&results[s * numDefenders * ivs->numDistinct], ivs->numDistinct,
+					variant[i], numDefenders, &winRate, &damage);
+				ok = fprintf(fh, "%d,%s,%s,%s,%.1f,%d,%d,%d,%d,%d,%.5f,%.2f\n", strategies[s],
+					specData[base->species].name, moves[base->basicMove].name,
+					moves[base->powerMove].name, (double)(mon.level + 1) * 0.5, i /
+					(NUM_IVS * NUM_IVS), (i / NUM_IVS) % NUM_IVS, i % NUM_IVS, cp[i],
+					hp[i % NUM_IVS], winRate, damage) > 0;
+			}
+		}
+	return ok;
+}
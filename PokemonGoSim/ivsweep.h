@@ -0,0 +1,45 @@
+#pragma once
+
+// Every IV combination of an attacking pokemon over a range of levels, collapsed to the
+// variants that fight differently against a set of defenders (the defenders' IVs stay fixed)
+
+#include "pokemon.h"
+
+// IV combinations at one level
+#define NUM_IV_COMBOS (NUM_IVS * NUM_IVS * NUM_IVS)
+
+typedef struct _IvSweep {
+	// Pokemon varied (its own level and IVs are ignored)
+	Pokemon base;
+	// CPM indexes of the first and last level
+	int minLevel;
+	int maxLevel;
+	// One pokemon for each set of variants that fight the same battles, level by level
+	Pokemon *distinct;
+	int numDistinct;
+	// First distinct pokemon of each level, then numDistinct
+	int *levelStart;
+	// Distinct pokemon that each variant fights as, indexed [level - minLevel][ivAttack]
+	// [ivDefense][ivHP]
+	int *variant;
+} IvSweep;
+
+// Column names of an IV table, which has one variant per line
+extern const char IV_TABLE_HEADER[];
+
+// Releases the pokemon and variants of an IV sweep
+void destroyIvSweep(IvSweep *ivs);
+// Groups the IVs of the pokemon at each level of minLevel .. maxLevel (CPM indexes) by the HP,
+// the damage done to each defender and the damage taken from each defender that they give;
+// variants that agree on all of them fight exactly the same battles. Returns false if out of
+// memory
+bool initIvSweep(IvSweep *ivs, const Pokemon *base, const Pokemon *defenders, int numDefenders,
+	int minLevel, int maxLevel);
+// Prints the number of distinct variants and the spread of the win rates at each level, from
+// the results of one strategy indexed [defender][distinct]
+void printIvLevels(const IvSweep *ivs, const RepeatBattleResult *results, int numDefenders);
+// Writes every variant as lines of an IV table with its results averaged over the defenders,
+// from the results indexed [strategy][defender][distinct]; returns false if it could not be
+// written
+bool writeIvTable(FILE *fh, const IvSweep *ivs, const RepeatBattleResult *results,
+	const int *strategies, int numStrategies, int numDefenders);
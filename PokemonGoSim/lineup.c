@@ -0,0 +1,149 @@
+#include "stdafx.h"
+#include "lineup.h"
+
+// A lineup being built, with where its gauntlet has got to
+typedef struct _LineupState {
+	Lineup lineup;
+	// Defender now fighting, and its HP left as a fraction
+	int def;
+	double defHP;
+} LineupState;
+
+// Matchup estimates, indexed [defender][attacker]
+typedef struct _LineupTable {
+	// HP lost by the attacker and the defender in a fight from full HP, as fractions of their
+	// HP (the winner's may be less than 1 after a timeout)
+	double *atkLoss;
+	double *defLoss;
+	// Length of the fight in ms
+	double *time;
+	int numAttackers;
+	int gymSize;
+} LineupTable;
+
+// Orders lineups from best to worst for qsort
+static int compareLineups(const void *a, const void *b) {
+	const Lineup *la = &((const LineupState *)a)->lineup, *lb = &((const LineupState *)b)->lineup;
+	int order = 0;
+	if (la->beaten != lb->beaten)
+		order = (la->beaten > lb->beaten) ? -1 : 1;
+	else if (la->losses != lb->losses)
+		order = la->losses - lb->losses;
+	else if (la->time != lb->time)
+		order = (la->time < lb->time) ? -1 : 1;
+	return order;
+}
+
+// Sends one more attacker in from full HP until it faints or the gym is beaten
+static void addAttacker(LineupState *state, const LineupTable *table, int attacker) {
+	Lineup *lineup = &state->lineup;
+	double hp = 1.0;
+	while (state->def < table->gymSize && hp > 0.0) {
+		int idx = state->def * table->numAttackers + attacker;
+		double atkLoss = table->atkLoss[idx], defLoss = table->defLoss[idx];
+		if (defLoss <= 0.0) {
+			// Cannot hurt this defender at all
+			lineup->time += table->time[idx] * hp;
+			hp = 0.0;
+		} else if (hp * defLoss >= state->defHP * atkLoss) {
+			// Beats the defender with HP to spare
+			hp -= state->defHP * atkLoss / defLoss;
+			lineup->time += state->defHP * table->time[idx] / defLoss;
+			state->def++;
+			state->defHP = 1.0;
+		} else {
+			// Faints, leaving the defender weakened
+			state->defHP -= hp * defLoss / atkLoss;
+			lineup->time += hp * table->time[idx] / atkLoss;
+			hp = 0.0;
+		}
+	}
+	lineup->order[lineup->size++] = attacker;
+	if (hp <= 0.0)
+		lineup->losses++;
+	lineup->beaten = (double)state->def + ((state->def < table->gymSize) ? 1.0 -
+		state->defHP : 0.0);
+}
+
+// Reports true if an attacker is already in a lineup
+static bool inLineup(const Lineup *lineup, int attacker) {
+	bool found = false;
+	for (int i = 0; i < lineup->size && !found; i++)
+		found = lineup->order[i] == attacker;
+	return found;
+}
+
+// Finds the lineups of teamSize attackers from the roster that beat the most of the gym, then
+// lose the fewest attackers, then take the least time. Every gauntlet is estimated by carrying
+// HP over between matchups at the rate each attacker and defender lost it in results, indexed
+// [defender][attacker]; lineups are built one slot at a time, keeping the best LINEUP_BEAM.
+// Stores up to count lineups, best first, and returns how many were found (0 if out of memory)
+int searchLineups(Lineup *best, int count, const RepeatBattleResult *results, int numAttackers,
+		int gymSize, int teamSize) {
+	size_t cells = (size_t)numAttackers * (size_t)gymSize;
+	LineupState *beam = (LineupState *)malloc(sizeof(LineupState) * LINEUP_BEAM),
+		*next = (LineupState *)malloc(sizeof(LineupState) * LINEUP_BEAM * (size_t)numAttackers);
+	LineupTable table;
+	// Attackers by how far each gets through the gym on its own, for the spare slots
+	int *solo = (int *)malloc(sizeof(int) * (size_t)numAttackers), found = 0, width = 1;
+	table.atkLoss = (double *)malloc(sizeof(double) * cells * 3U);
+	table.numAttackers = numAttackers;
+	table.gymSize = gymSize;
+	if (teamSize > numAttackers)
+		teamSize = numAttackers;
+	if (beam != NULL && next != NULL && solo != NULL && table.atkLoss != NULL) {
+		table.defLoss = &table.atkLoss[cells];
+		table.time = &table.defLoss[cells];
+		for (size_t i = 0; i < cells; i++) {
+			const RepeatBattleResult *result = &results[i];
+			table.atkLoss[i] = result->avgAtkDamage / (double)(getHP(result->attacking) *
+				battleRules.atkHPMult);
+			table.defLoss[i] = result->avgDefDamage / (double)(getHP(result->defending) *
+				battleRules.defHPMult);
+			table.time[i] = (double)battleRules.maxTime - result->avgTimeLeft;
+		}
+		for (int a = 0; a < numAttackers; a++) {
+			memset(&next[a], 0, sizeof(LineupState));
+			next[a].defHP = 1.0;
+			addAttacker(&next[a], &table, a);
+		}
+		qsort(next, (size_t)numAttackers, sizeof(LineupState), compareLineups);
+		for (int a = 0; a < numAttackers; a++)
+			solo[a] = next[a].lineup.order[0];
+		// Start from the empty lineup
+		memset(&beam[0], 0, sizeof(LineupState));
+		beam[0].defHP = 1.0;
+		for (int slot = 0; slot < teamSize; slot++) {
+			int children = 0;
+			for (int i = 0; i < width; i++) {
+				const LineupState *state = &beam[i];
+				if (state->def >= gymSize) {
+					// Beaten already, so only the best spare is worth adding
+					LineupState *child = &next[children++];
+					int spare = 0;
+					while (inLineup(&state->lineup, solo[spare]))
+						spare++;
+					*child = *state;
+					child->lineup.order[child->lineup.size++] = solo[spare];
+				} else
+					for (int a = 0; a < numAttackers; a++)
+						if (!inLineup(&state->lineup, a)) {
+							LineupState *child = &next[children++];
+							*child = *state;
+							addAttacker(child, &table, a);
+						}
+			}
+			qsort(next, (size_t)children, sizeof(LineupState), compareLineups);
+			width = (children < LINEUP_BEAM) ? children : LINEUP_BEAM;
+			memcpy(beam, next, sizeof(LineupState) * (size_t)width);
+		}
+		found = (width < count) ? width : count;
+		for (int i = 0; i < found; i++)
+			best[i] = beam[i].lineup;
+	}
+	free(table.atkLoss);
+	free(solo);
+	free(next);
+	free(beam);
+	return found;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Search for the team and fighting order that does best against a gym, estimated from the
+// results of every attacker against every defender and then checked by running gauntlets
+
+#include "gauntlet.h"
+
+// Partial lineups kept after each slot is filled
+#define LINEUP_BEAM 256
+// Best lineups of the search that are checked with gauntlets
+#define LINEUP_VERIFY 8
+
+// One team in fighting order, with its estimated gauntlet
+typedef struct _Lineup {
+	// Index of each attacker in the roster
+	int order[MAX_TEAM];
+	int size;
+	// Estimated defenders beaten (with the fraction of HP taken from the last one standing),
+	// attackers lost and time in ms
+	double beaten;
+	int losses;
+	double time;
+} Lineup;
+
+// Finds the lineups of teamSize attackers from the roster that beat the most of the gym, then
+// lose the fewest attackers, then take the least time. Every gauntlet is estimated by carrying
+// HP over between matchups at the rate each attacker and defender lost it in results, indexed
+// [defender][attacker]; lineups are built one slot at a time, keeping the best LINEUP_BEAM.
+// Stores up to count lineups, best first, and returns how many were found (0 if out of memory)
+int searchLineups(Lineup *best, int count, const RepeatBattleResult *results, int numAttackers,
+	int gymSize, int teamSize);
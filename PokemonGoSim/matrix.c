@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "matrix.h"
+
+// Starts every binary matrix
+static const char MATRIX_MAGIC[8] = { 'P', 'G', 'S', 'M', 'A', 'T', 'R', 'X' };
+
+// Start of a binary matrix, followed by the strategies (int32 each), the attackers and the
+// defenders (as Pokemon records), then the cells indexed by [strategy][defender][attacker]
+typedef struct _MatrixHeader {
+	char magic[8];
+	// MATRIX_VERSION
+	uint32_t version;
+	uint32_t numStrategies;
+	uint32_t numAttackers;
+	uint32_t numDefenders;
+} MatrixHeader;
+
+// Result of one matchup in a binary matrix
+typedef struct _MatrixCell {
+	// Attacker win rate and its 95% confidence interval half width
+	float winRate;
+	float winError;
+	// Average damage done to the attacker and to the defender
+	float atkDamage;
+	float defDamage;
+	// Average time left on the battle clock in ms
+	float timeLeft;
+	// Battles fought
+	int32_t battles;
+} MatrixCell;
+
+// Column names of a CSV matrix, which has one matchup per line
+const char MATRIX_CSV_HEADER[] = "Strategy,Attacker,Attacker Basic,Attacker Charge,Defender,"
+	"Defender Basic,Defender Charge,Win Rate,Win Error,Attacker Damage,Defender Damage,"
+	"Time Left,Battles\n";
+
+// Writes one pokemon as the species and move names for CSV
+static void writeCsvPokemon(FILE *fh, const Pokemon *mon) {
+	fprintf(fh, "%s,%s,%s,", specData[mon->species].name, moves[mon->basicMove].name,
+		moves[mon->powerMove].name);
+}
+
+// Writes one matchup as a line of a CSV matrix; returns false if it could not be written
+bool writeCsvMatchup(FILE *fh, int strategy, const Pokemon *attack, const Pokemon *defense,
+		const RepeatBattleResult *result) {
+	fprintf(fh, "%d,", strategy);
+	writeCsvPokemon(fh, attack);
+	writeCsvPokemon(fh, defense);
+	return fprintf(fh, "%.5f,%.5f,%.2f,%.2f,%.0f,%d\n", result->winRate, result->winError,
+		result->avgAtkDamage, result->avgDefDamage, result->avgTimeLeft, result->ntimes) > 0;
+}
+
+// Writes a matrix as CSV, one matchup per line
+static bool writeCsv(const Matrix *matrix, FILE *fh) {
+	int na = matrix->numAttackers, nd = matrix->numDefenders;
+	bool ok = fputs(MATRIX_CSV_HEADER, fh) >= 0;
+	for (int s = 0; s < matrix->numStrategies && ok; s++)
+		for (int d = 0; d < nd && ok; d++) {
+			const RepeatBattleResult *result = &matrix->results[(s * nd + d) * na];
+			for (int a = 0; a < na && ok; a++, result++)
+				ok = writeCsvMatchup(fh, matrix->strategies[s], &matrix->attackers[a],
+					&matrix->defenders[d], result);
+		}
+	return ok;
+}
+
+// Writes a matrix as a binary file
+static bool writeBinary(const Matrix *matrix, FILE *fh) {
+	int na = matrix->numAttackers, nd = matrix->numDefenders, ns = matrix->numStrategies;
+	size_t cells = (size_t)ns * (size_t)nd * (size_t)na;
+	MatrixHeader header;
+	bool ok;
+	memcpy(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC));
+	header.version = MATRIX_VERSION;
+	header.numStrategies = (uint32_t)ns;
+	header.numAttackers = (uint32_t)na;
+	header.numDefenders = (uint32_t)nd;
+	ok = fwrite(&header, sizeof(header), 1, fh) == 1;
+	for (int s = 0; s < ns && ok; s++) {
+		int32_t strategy = (int32_t)matrix->strategies[s];
+		ok = fwrite(&strategy, sizeof(strategy), 1, fh) == 1;
+	}
+	ok = ok && fwrite(matrix->attackers, sizeof(Pokemon), (size_t)na, fh) == (size_t)na &&
+		fwrite(matrix->defenders, sizeof(Pokemon), (size_t)nd, fh) == (size_t)nd;
+	for (size_t i = 0; i < cells && ok; i++) {
+		const RepeatBattleResult *result = &matrix->results[i];
+		MatrixCell cell;
+		cell.winRate = (float)result->winRate;
+		cell.winError = (float)result->winError;
+		cell.atkDamage = (float)result->avgAtkDamage;
+		cell.defDamage = (float)result->avgDefDamage;
+		cell.timeLeft = (float)result->avgTimeLeft;
+		cell.battles = (int32_t)result->ntimes;
+		ok = fwrite(&cell, sizeof(cell), 1, fh) == 1;
+	}
+	return ok;
+}
+
+// Writes a matrix as CSV if the file name ends in .csv, or else as a binary file; returns false
+// if the file could not be written
+bool writeMatrix(const Matrix *matrix, const char *fileName) {
+	size_t len = strlen(fileName);
+	bool csv = len >= 4U && _strcmpi(&fileName[len - 4U], ".csv") == 0, ok = false;
+	FILE *fh;
+	if (fopen_s(&fh, fileName, csv ? "w" : "wb") == 0 && fh != NULL) {
+		ok = csv ? writeCsv(matrix, fh) : writeBinary(matrix, fh);
+		ok = fclose(fh) == 0 && ok;
+	}
+	return ok;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Output of an all vs all sweep: one result for every strategy, defender and attacker
+
+#include "pokemon.h"
+
+// Change whenever the binary matrix layout changes
+#define MATRIX_VERSION 1
+
+typedef struct _Matrix {
+	// Results, indexed by [strategy][defender][attacker]
+	const RepeatBattleResult *results;
+	// STRAT_x of each strategy
+	const int *strategies;
+	int numStrategies;
+	// Attacking pokemon
+	const Pokemon *attackers;
+	int numAttackers;
+	// Defending pokemon
+	const Pokemon *defenders;
+	int numDefenders;
+} Matrix;
+
+// Column names of a CSV matrix, which has one matchup per line
+extern const char MATRIX_CSV_HEADER[];
+
+// Writes one matchup as a line of a CSV matrix; returns false if it could not be written
+bool writeCsvMatchup(FILE *fh, int strategy, const Pokemon *attack, const Pokemon *defense,
+	const RepeatBattleResult *result);
+// Writes a matrix as CSV if the file name ends in .csv, or else as a binary file; returns false
+// if the file could not be written
+bool writeMatrix(const Matrix *matrix, const char *fileName);
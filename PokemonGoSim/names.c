@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "names.h"
+
+// Slots in the smallest hash table (a power of 2)
+#define NAME_MIN_SLOTS 16U
+
+typedef struct _NameIndex {
+	// Open addressing hash table of (index + 1), 0 for an empty slot, with (mask + 1) slots
+	int *slots;
+	size_t mask;
+	// Named indexes sorted by name ignoring case
+	int *sorted;
+	int count;
+} NameIndex;
+
+// Indexes of the move and species names
+static NameIndex moveIndex = { NULL, 0U, NULL, 0 };
+static NameIndex speciesIndex = { NULL, 0U, NULL, 0 };
+
+// Gets the name of a move or species, NULL if it has none
+static inline const char * nameOf(int idx, bool species) {
+	return species ? specData[idx].name : moves[idx].name;
+}
+
+// Converts an ASCII letter to lower case
+static inline uint32_t lowerCase(char c) {
+	return (uint32_t)(unsigned char)((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c);
+}
+
+// Calculates the FNV-1a hash of a name ignoring case
+static size_t hashName(const char *name) {
+	uint32_t hash = 2166136261U;
+	for (; *name != '\0'; name++)
+		hash = (hash ^ lowerCase(*name)) * 16777619U;
+	return (size_t)hash;
+}
+
+// Sorts move indexes by name for qsort
+static int compareMoves(const void *a, const void *b) {
+	return _strcmpi(moves[*(const int *)a].name, moves[*(const int *)b].name);
+}
+
+// Sorts species indexes by name for qsort
+static int compareSpecies(const void *a, const void *b) {
+	return _strcmpi(specData[*(const int *)a].name, specData[*(const int *)b].name);
+}
+
+// Deallocates one index
+static void destroyIndex(NameIndex *index) {
+	free(index->slots);
+	free(index->sorted);
+	index->slots = NULL;
+	index->mask = 0U;
+	index->sorted = NULL;
+	index->count = 0;
+}
+
+// Looks up an exact name ignoring case in one index
+static int findIndex(const NameIndex *index, const char *name, bool species) {
+	int entry, found = -1;
+	if (index->slots != NULL) {
+		size_t mask = index->mask, slot = hashName(name) & mask;
+		while ((entry = index->slots[slot]) != 0 && found < 0) {
+			if (_strcmpi(name, nameOf(entry - 1, species)) == 0)
+				found = entry - 1;
+			slot = (slot + 1U) & mask;
+		}
+	}
+	return found;
+}
+
+// Builds one index over the first count moves or species; returns false if out of memory
+static bool buildIndex(NameIndex *index, int count, bool species) {
+	size_t size = NAME_MIN_SLOTS, named = 0U;
+	bool ok = false;
+	destroyIndex(index);
+	for (int i = 0; i < count; i++)
+		if (nameOf(i, species) != NULL)
+			named++;
+	// Keep at least half of the slots empty
+	while (size < (named << 1))
+		size <<= 1;
+	index->slots = (int *)calloc(size, sizeof(int));
+	index->sorted = (int *)malloc(sizeof(int) * (named + 1U));
+	if (index->slots != NULL && index->sorted != NULL) {
+		index->mask = size - 1U;
+		for (int i = 0; i < count; i++) {
+			const char *name = nameOf(i, species);
+			// Duplicate names keep the lowest index
+			if (name != NULL && findIndex(index, name, species) < 0) {
+				size_t slot = hashName(name) & index->mask;
+				while (index->slots[slot] != 0)
+					slot = (slot + 1U) & index->mask;
+				index->slots[slot] = i + 1;
+				index->sorted[index->count++] = i;
+			}
+		}
+		qsort(index->sorted, (size_t)index->count, sizeof(int), species ? compareSpecies :
+			compareMoves);
+		ok = true;
+	} else
+		destroyIndex(index);
+	return ok;
+}
+
+// Counts the single letter insertions, deletions and changes (ignoring case) that turn one
+// name into another
+static int editDistance(const char *a, const char *b) {
+	int row[BUFFER_SIZE + 1U], len = (int)strnlen(b, BUFFER_SIZE);
+	for (int j = 0; j <= len; j++)
+		row[j] = j;
+	for (int i = 1; *a != '\0'; a++, i++) {
+		// Distance between the shorter prefixes
+		int diag = row[0];
+		row[0] = i;
+		for (int j = 1; j <= len; j++) {
+			int up = row[j], best = diag + ((lowerCase(*a) == lowerCase(b[j - 1])) ? 0 : 1);
+			if (up + 1 < best)
+				best = up + 1;
+			if (row[j - 1] + 1 < best)
+				best = row[j - 1] + 1;
+			diag = up;
+			row[j] = best;
+		}
+	}
+	return row[len];
+}
+
+// Finds the only closest name within NAME_MAX_TYPOS edits of the text, or -1 if there is a
+// tie or nothing is close
+static int closestName(const NameIndex *index, const char *text, bool species) {
+	int best = NAME_MAX_TYPOS + 1, found = -1;
+	for (int i = 0; i < index->count; i++) {
+		int idx = index->sorted[i], dist = editDistance(text, nameOf(idx, species));
+		if (dist < best) {
+			best = dist;
+			found = idx;
+		} else if (dist == best)
+			found = -1;
+	}
+	return found;
+}
+
+// Deallocates the name indexes (call before the names are freed or unmapped)
+void destroyNames() {
+	destroyIndex(&moveIndex);
+	destroyIndex(&speciesIndex);
+}
+
+// Gets the move or species index by its exact name ignoring case, or -1 if there is none
+int findName(const char *name, bool species) {
+	return findIndex(species ? &speciesIndex : &moveIndex, name, species);
+}
+
+// Builds the hashed and sorted name indexes of the loaded moves and species; returns false if
+// out of memory
+bool indexNames() {
+	return buildIndex(&moveIndex, MAX_MOVE_INDEX, false) && buildIndex(&speciesIndex,
+		NUM_SPECIES, true);
+}
+
+// Gets the move or species index for typed input: an exact name, the only name starting with
+// the text, or else the only closest name within NAME_MAX_TYPOS edits; -1 if none matches
+int matchName(const char *text, bool species) {
+	const NameIndex *index = species ? &speciesIndex : &moveIndex;
+	size_t len = strlen(text);
+	int found = findIndex(index, text, species);
+	if (found < 0 && len > 0U) {
+		int l = 0, r = index->count, matches = 0;
+		while (l < r) {
+			// Binary search for the first name not sorting before the text
+			int m = (l + r) >> 1;
+			if (_strcmpi(nameOf(index->sorted[m], species), text) < 0)
+				l = m + 1;
+			else
+				r = m;
+		}
+		// Names starting with the text all follow from there
+		while (l + matches < index->count && matches < 2 && _strnicmp(nameOf(
+				index->sorted[l + matches], species), text, len) == 0)
+			matches++;
+		if (matches == 1)
+			found = index->sorted[l];
+		else if (matches == 0)
+			found = closestName(index, text, species);
+	}
+	return found;
+}
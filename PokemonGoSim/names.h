@@ -0,0 +1,19 @@
+#pragma once
+
+// Case insensitive indexes of the move and species names, built once the game data is loaded
+
+#include "pokemon.h"
+
+// Most spelling mistakes forgiven by matchName
+#define NAME_MAX_TYPOS 2
+
+// Deallocates the name indexes (call before the names are freed or unmapped)
+void destroyNames();
+// Gets the move or species index by its exact name ignoring case, or -1 if there is none
+int findName(const char *name, bool species);
+// Builds the hashed and sorted name indexes of the loaded moves and species; returns false if
+// out of memory
+bool indexNames();
+// Gets the move or species index for typed input: an exact name, the only name starting with
+// the text, or else the only closest name within NAME_MAX_TYPOS edits; -1 if none matches
+int matchName(const char *text, bool species);
@@ -0,0 +1,324 @@
+#include "stdafx.h"
+#include "platform.h"
+
+#ifdef COUNT_ALLOCATIONS
+// The wrappers call the real allocator
+#undef calloc
+#undef malloc
+#undef realloc
+
+// Heap allocations made so far
+static volatile long long allocations = 0LL;
+
+#ifdef _WIN32
+#define COUNT_ALLOCATION() InterlockedIncrement64(&allocations)
+#else
+#define COUNT_ALLOCATION() __atomic_fetch_add(&allocations, 1LL, __ATOMIC_RELAXED)
+#endif
+
+// Counts a call to calloc
+void * countedCalloc(size_t count, size_t size) {
+	COUNT_ALLOCATION();
+	return calloc(count, size);
+}
+
+// Counts a call to malloc
+void * countedMalloc(size_t size) {
+	COUNT_ALLOCATION();
+	return malloc(size);
+}
+
+// Counts a call to realloc
+void * countedRealloc(void *ptr, size_t size) {
+	COUNT_ALLOCATION();
+	return realloc(ptr, size);
+}
+
+// Reports the number of heap allocations made so far by all threads
+long long getAllocations() {
+	return allocations;
+}
+#endif
+
+#ifdef _WIN32
+// Reports the number of logical processors available
+int getNumCores() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+// Waits for a thread to finish and releases it
+void joinThread(Thread thread) {
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+}
+
+// Starts a new thread running proc(arg), returns false if the thread could not be created
+bool startThread(Thread *thread, ThreadProc proc, void *arg) {
+	HANDLE handle = CreateThread(NULL, 0, proc, arg, 0, NULL);
+	*thread = handle;
+	return handle != NULL;
+}
+
+// Deletes a mutex
+void destroyMutex(Mutex *mutex) {
+	DeleteCriticalSection(mutex);
+}
+
+// Initializes a mutex
+void initMutex(Mutex *mutex) {
+	InitializeCriticalSection(mutex);
+}
+
+// Locks a mutex
+void lockMutex(Mutex *mutex) {
+	EnterCriticalSection(mutex);
+}
+
+// Unlocks a mutex
+void unlockMutex(Mutex *mutex) {
+	LeaveCriticalSection(mutex);
+}
+
+// Reads a shared counter, seeing every write made by the thread that stored it before storing
+long long atomicLoad(volatile long long *value) {
+	return InterlockedCompareExchange64(value, 0LL, 0LL);
+}
+
+// Stores to a shared counter, publishing every write made before it to threads that load it
+void atomicStore(volatile long long *value, long long newValue) {
+	InterlockedExchange64(value, newValue);
+}
+
+// Replaces a shared counter if it still holds the expected value; returns false if it did not
+bool atomicSwap(volatile long long *value, long long expected, long long newValue) {
+	return InterlockedCompareExchange64(value, newValue, expected) == expected;
+}
+
+// Suspends the calling thread for at least the specified time in ms (0 = gives up its turn)
+void sleepMillis(int ms) {
+	Sleep((DWORD)ms);
+}
+
+// Reads a monotonic clock in seconds, for timing
+double getSeconds() {
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (double)count.QuadPart / (double)freq.QuadPart;
+}
+
+// Maps a whole file read only into memory; returns false if it could not be opened or mapped
+bool mapFile(MappedFile *file, const char *fileName) {
+	LARGE_INTEGER size;
+	file->data = NULL;
+	file->size = 0U;
+	file->mapping = NULL;
+	file->file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file->file != INVALID_HANDLE_VALUE) {
+		if (GetFileSizeEx(file->file, &size) && size.QuadPart > 0LL) {
+			file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (file->mapping != NULL) {
+				file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+				file->size = (size_t)size.QuadPart;
+			}
+		}
+		if (file->data == NULL)
+			unmapFile(file);
+	}
+	return file->data != NULL;
+}
+
+// Releases a mapped file
+void unmapFile(MappedFile *file) {
+	if (file->data != NULL)
+		UnmapViewOfFile(file->data);
+	if (file->mapping != NULL)
+		CloseHandle(file->mapping);
+	if (file->file != INVALID_HANDLE_VALUE)
+		CloseHandle(file->file);
+	file->data = NULL;
+	file->size = 0U;
+	file->mapping = NULL;
+	file->file = INVALID_HANDLE_VALUE;
+}
+
+// Renames a file over another one in a single step; returns false if it could not
+bool replaceFile(const char *from, const char *to) {
+	// rename will not replace an existing file on Windows
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Most pointers that one fscanf_s call may fill in
+#define SCAN_MAX_ARGS 8
+
+// fscanf_s replacement: converts the buffer sizes after %s, %c and %[ into field widths
+int compatScanf(FILE *fh, const char *format, ...) {
+	char fmt[256], *out = fmt, *end = &fmt[sizeof(fmt) - 16];
+	void *args[SCAN_MAX_ARGS] = { NULL };
+	int count = 0;
+	va_list ap;
+	va_start(ap, format);
+	while (*format != '\0' && out < end) {
+		bool suppress = false, width = false;
+		char conv;
+		if ((*out++ = *format++) != '%')
+			continue;
+		if (*format == '%') {
+			// Literal percent
+			*out++ = *format++;
+			continue;
+		}
+		if (*format == '*') {
+			*out++ = *format++;
+			suppress = true;
+		}
+		while (*format >= '0' && *format <= '9') {
+			*out++ = *format++;
+			width = true;
+		}
+		while (*format == 'h' || *format == 'l' || *format == 'z' || *format == 'j')
+			*out++ = *format++;
+		conv = *format;
+		if (!suppress && (conv == 's' || conv == '[' || conv == 'c')) {
+			void *ptr = va_arg(ap, void *);
+			unsigned int size = va_arg(ap, unsigned int);
+			// Leave room for the terminator
+			if (!width && conv != 'c' && size > 1U)
+				out += sprintf(out, "%u", size - 1U);
+			if (count < SCAN_MAX_ARGS)
+				args[count++] = ptr;
+		} else if (!suppress && conv != '\0' && count < SCAN_MAX_ARGS)
+			args[count++] = va_arg(ap, void *);
+		if (conv == '[') {
+			// Copy the scan set through the closing bracket
+			*out++ = *format++;
+			if (*format == '^')
+				*out++ = *format++;
+			if (*format == ']')
+				*out++ = *format++;
+			while (*format != '\0' && *format != ']' && out < end)
+				*out++ = *format++;
+		}
+		if (*format != '\0')
+			*out++ = *format++;
+	}
+	*out = '\0';
+	va_end(ap);
+	return fscanf(fh, fmt, args[0], args[1], args[2], args[3], args[4], args[5], args[6],
+		args[7]);
+}
+
+// Reports the number of logical processors available
+int getNumCores() {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	return cores > 0L ? (int)cores : 1;
+}
+
+// Waits for a thread to finish and releases it
+void joinThread(Thread thread) {
+	pthread_join(thread, NULL);
+}
+
+// Starts a new thread running proc(arg), returns false if the thread could not be created
+bool startThread(Thread *thread, ThreadProc proc, void *arg) {
+	return pthread_create(thread, NULL, proc, arg) == 0;
+}
+
+// Deletes a mutex
+void destroyMutex(Mutex *mutex) {
+	pthread_mutex_destroy(mutex);
+}
+
+// Initializes a mutex
+void initMutex(Mutex *mutex) {
+	pthread_mutex_init(mutex, NULL);
+}
+
+// Locks a mutex
+void lockMutex(Mutex *mutex) {
+	pthread_mutex_lock(mutex);
+}
+
+// Unlocks a mutex
+void unlockMutex(Mutex *mutex) {
+	pthread_mutex_unlock(mutex);
+}
+
+// Reads a shared counter, seeing every write made by the thread that stored it before storing
+long long atomicLoad(volatile long long *value) {
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+// Stores to a shared counter, publishing every write made before it to threads that load it
+void atomicStore(volatile long long *value, long long newValue) {
+	__atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+// Replaces a shared counter if it still holds the expected value; returns false if it did not
+bool atomicSwap(volatile long long *value, long long expected, long long newValue) {
+	return __atomic_compare_exchange_n(value, &expected, newValue, false, __ATOMIC_ACQ_REL,
+		__ATOMIC_ACQUIRE);
+}
+
+// Suspends the calling thread for at least the specified time in ms (0 = gives up its turn)
+void sleepMillis(int ms) {
+	if (ms > 0) {
+		struct timespec wait;
+		wait.tv_sec = ms / 1000;
+		wait.tv_nsec = (long)(ms % 1000) * 1000000L;
+		nanosleep(&wait, NULL);
+	} else
+		sched_yield();
+}
+
+// Reads a monotonic clock in seconds, for timing
+double getSeconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// Maps a whole file read only into memory; returns false if it could not be opened or mapped
+bool mapFile(MappedFile *file, const char *fileName) {
+	int fd = open(fileName, O_RDONLY);
+	struct stat info;
+	file->data = NULL;
+	file->size = 0U;
+	if (fd >= 0) {
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				file->data = data;
+				file->size = (size_t)info.st_size;
+			}
+		}
+		// The mapping stays valid after the file is closed
+		close(fd);
+	}
+	return file->data != NULL;
+}
+
+// Releases a mapped file
+void unmapFile(MappedFile *file) {
+	if (file->data != NULL)
+		munmap((void *)file->data, file->size);
+	file->data = NULL;
+	file->size = 0U;
+}
+
+// Renames a file over another one in a single step; returns false if it could not
+bool replaceFile(const char *from, const char *to) {
+	return rename(from, to) == 0;
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+// Threads, locks, atomics, mapped and renamed files and timers for Windows and Linux
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+// Thread entry points must be declared with THREAD_PROC and return THREAD_DONE
+#define THREAD_PROC(_name, _arg) DWORD WINAPI _name(LPVOID _arg)
+// Gives each thread its own copy of a global
+#define THREAD_LOCAL __declspec(thread)
+#define THREAD_DONE 0
+typedef DWORD (WINAPI *ThreadProc)(LPVOID arg);
+
+typedef struct _MappedFile {
+	// Read only view of the whole file (NULL if not mapped)
+	const void *data;
+	size_t size;
+	HANDLE file;
+	HANDLE mapping;
+} MappedFile;
+#else
+#include <pthread.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+// Thread entry points must be declared with THREAD_PROC and return THREAD_DONE
+#define THREAD_PROC(_name, _arg) void * _name(void *_arg)
+// Gives each thread its own copy of a global
+#define THREAD_LOCAL __thread
+#define THREAD_DONE NULL
+typedef void * (*ThreadProc)(void *arg);
+
+typedef struct _MappedFile {
+	// Read only view of the whole file (NULL if not mapped)
+	const void *data;
+	size_t size;
+} MappedFile;
+#endif
+
+// Reports the number of logical processors available
+int getNumCores();
+// Waits for a thread to finish and releases it
+void joinThread(Thread thread);
+// Starts a new thread running proc(arg), returns false if the thread could not be created
+bool startThread(Thread *thread, ThreadProc proc, void *arg);
+
+// Deletes a mutex
+void destroyMutex(Mutex *mutex);
+// Initializes a mutex
+void initMutex(Mutex *mutex);
+// Locks a mutex
+void lockMutex(Mutex *mutex);
+// Unlocks a mutex
+void unlockMutex(Mutex *mutex);
+
+// Reads a shared counter, seeing every write made by the thread that stored it before storing
+long long atomicLoad(volatile long long *value);
+// Stores to a shared counter, publishing every write made before it to threads that load it
+void atomicStore(volatile long long *value, long long newValue);
+// Replaces a shared counter if it still holds the expected value; returns false if it did not
+bool atomicSwap(volatile long long *value, long long expected, long long newValue);
+// Suspends the calling thread for at least the specified time in ms (0 = gives up its turn)
+void sleepMillis(int ms);
+
+// Reads a monotonic clock in seconds, for timing
+double getSeconds();
+
+// Maps a whole file read only into memory; returns false if it could not be opened or mapped
+bool mapFile(MappedFile *file, const char *fileName);
+// Releases a mapped file
+void unmapFile(MappedFile *file);
+// Renames a file over another one in a single step, so that readers see either the old file or
+// the new one; returns false if it could not
+bool replaceFile(const char *from, const char *to);
@@ -42,14 +42,18 @@
 #define NUM_SPECIES 75
 // Maximum index used for a move
 #define MAX_MOVE_INDEX 242
-// Maximum number of defender combinations which will be tried
-#define MAX_DEFENDERS 512
-// How many events to store in the timeline
-#define TIMELINE_LEN 512
+// How many events the timeline ring buffer holds (must be a power of 2)
+#define TIMELINE_LEN 128
+// Wraps a timeline index into the ring buffer
+#define TIMELINE_MASK (TIMELINE_LEN - 1)
 // Maximum number of learnable basic moves per pokemon
 #define MAX_BASIC_MOVES 2
 // Maximum number of learnable special moves per pokemon
 #define MAX_SPECIAL_MOVES 3
+// Values each IV can take (0 to 15)
+#define NUM_IVS 16
+// Entries in the CPM table; level n is Poke Go level (n + 1) / 2, from 1 to 40
+#define NUM_LEVELS 80
 
 // After this many HP lost, the victim will gain 1 energy
 #define HP_TO_ENERGY 2
@@ -57,8 +61,8 @@
 #define MULT_STAB 1.25
 // Multiplier for Super Effective (1/x for Not Very Effective)
 #define MULT_SUPER 1.25
-// Dodging negates 75% of all damage (this is done in integer! No parentheses!)
-#define MULT_DODGE 1 / 4
+// Dodging negates 75% of all damage (percent still done, in integer)
+#define DODGE_PERCENT 25
 // Time taken to dodge
 #define DODGE_TIME 500
 // If we have to wait between our quick attack and the dodge, start dodge this many ms before
@@ -91,6 +95,8 @@
 #define STRAT_DODGE_CHARGE 1
 // Dodge all moves
 #define STRAT_DODGE_ALL 2
+// Number of STRAT_x strategies
+#define NUM_STRATS 3
 
 // Nothing
 #define EVENT_NOP 0
@@ -100,6 +106,8 @@
 #define EVENT_SPECIAL 2
 // Dodge
 #define EVENT_DODGE 3
+// Number of EVENT_x types
+#define NUM_EVENTS 4
 
 typedef struct _Species {
 	int number;
@@ -182,6 +190,12 @@ typedef struct _RepeatBattleResult {
 	int ntimes;
 	// Number of attacker wins (balance is defender wins or timeouts)
 	int atkWins;
+	// Fraction of battles won by the attacker
+	double winRate;
+	// Half width of the 95% confidence interval of the win rate atkWins / ntimes
+	double winError;
+	// Half width of the 95% confidence interval of avgAtkDamage
+	double atkDamageError;
 } RepeatBattleResult;
 
 typedef struct _FightEvent {
@@ -191,17 +205,19 @@ typedef struct _FightEvent {
 	int type;
 	// Event duration
 	int duration;
+	// Energy the side gained when the event was planned (negative if spent)
+	int energy;
 } FightEvent;
 
 typedef struct _Timeline {
-	// Timeline data
-	FightEvent *data;
-	// Current plan index
+	// Timeline data, a ring buffer indexed by (plan or exec) & TIMELINE_MASK
+	FightEvent data[TIMELINE_LEN];
+	// Number of events planned so far
 	int plan;
-	// Current execution index
+	// Number of events executed so far
 	int exec;
-	// Last attack or dodge event executed
-	FightEvent *lastAttack;
+	// Copy of the last attack or dodge event executed
+	FightEvent lastAttack;
 } Timeline;
 
 // CP multiplier
@@ -211,35 +227,39 @@ extern const int SUPER_EFFECTIVE[NUM_TYPES][NUM_TYPES];
 // Species type names
 extern const char * const TYPES[];
 
-// All defenders to pit the attackers against
-extern Pokemon defenders[];
+// All defenders to pit the attackers against, followed by the attackers (allocated to fit the
+// rosters, NULL until they are read)
+extern Pokemon *defenders;
 // Moves by ID
 extern Move moves[];
 // Global species data filled by readSpecies()
 extern Species specData[];
 
-// Clears all events from the timeline object
+// Clears all events from the timeline object; old event data is left to be overwritten
 void clearTimeline(Timeline *timeline);
-// Deallocate all non null *name in globals
+// Deallocate all non null *name in globals, and the rosters
 void destroyAll();
-// Destroys the timeline object
-void destroyTimeline(Timeline *timeline);
 // Calculates the CP of a pokemon
 int getCP(const Pokemon *mon);
+// Calculates the CP of a species at the level of a pokemon for every IV combination, indexed
+// [ivAttack][ivDefense][ivHP]
+void getCPs(int cp[NUM_IVS * NUM_IVS * NUM_IVS], const Pokemon *mon);
 // Calculates damage of the specified move
-int getDamage(const Pokemon *attack, const Pokemon *defense, const Move *move, bool dodge);
+int getDamage(const Pokemon *attack, const Pokemon *defense, const Move *move);
 // Calculates the HP of a pokemon
 int getHP(const Pokemon *mon);
+// Calculates the HP of a species at the level of a pokemon for every HP IV
+void getHPs(int hp[NUM_IVS], const Pokemon *mon);
 // Gets the move index by its name; case insensitive matching
-// Slow! Do not run in a loop!
 int getMoveName(const char *name);
 // Gets the species index by the # in the pokedex
 int getSpeciesNumber(int number);
 // Gets the species index by its name; case insensitive matching
-// Slow! Do not run in a loop!
 int getSpeciesName(const char *name);
-// Initializes the timeline object
-void initTimeline(Timeline *timeline);
+#ifdef _DEBUG
+// Prints out a damage notification for one hit
+void printDamage(const Pokemon *defense, const Move *move, int damage, bool dodge);
+#endif
 // Prints out a pokemon detail
 void printPokemon(const Pokemon *mon);
 // Read in basic move data
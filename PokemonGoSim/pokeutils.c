@@ -1,5 +1,7 @@
 #include "stdafx.h"
+#include "names.h"
 #include "pokemon.h"
+#include "rules.h"
 
 // Flags for super effective / not very effective
 #define S 1
@@ -136,7 +138,7 @@ const int SUPER_EFFECTIVE[NUM_TYPES][NUM_TYPES] = {
 	{ 0,0,0,0,N,0,N,N,0,0,0,0,0,0,0,0,0,0 }  // NOR
 };
 
-Pokemon defenders[MAX_DEFENDERS];
+Pokemon *defenders = NULL;
 Move moves[MAX_MOVE_INDEX];
 Species specData[NUM_SPECIES];
 
@@ -166,6 +168,36 @@ static inline bool isSTAB(const Move *move, const Species *attack) {
 	return attack->type[0] == move->type || attack->type[1] == move->type;
 }
 
+// Works out the STAB and type effectiveness multipliers of a move under the given rules
+static double getMultipliers(const Move *move, const Species *atkSpec, const Species *defSpec,
+		const Rules *rules) {
+	int effective = getEffectiveness(move, defSpec);
+	double multSuper = rules->multSuper, multipliers = (isSTAB(move, atkSpec) ?
+		rules->multStab : 1.00);
+	switch (effective) {
+	case 1:
+		// It's super effective!
+		multipliers *= multSuper;
+		break;
+	case 2:
+		// It's super effective!
+		multipliers *= (multSuper * multSuper);
+		break;
+	case -1:
+		// It's not very effective...
+		multipliers *= 1.0 / multSuper;
+		break;
+	case -2:
+		// It's not very effective...
+		multipliers *= 1.0 / (multSuper * multSuper);
+		break;
+	default:
+		// Max 2 advantages
+		break;
+	}
+	return multipliers;
+}
+
 // Copies the name from a temporary buffer to dynamic memory, returning the new copy
 static char * copyName(const char *buffer, int maxLen) {
 	char *name = NULL;
@@ -195,23 +227,22 @@ static void printMoveList(const int *data, int count) {
 }
 #endif
 
-// Clears all events from the timeline object
+// Clears all events from the timeline object; old event data is left to be overwritten
 void clearTimeline(Timeline *timeline) {
-	FightEvent *head = &(timeline->data[0]);
-	for (uint32_t i = TIMELINE_LEN; i; i--) {
-		head->duration = 0;
-		head->time = INT_MAX;
-		head->type = 0;
-		head++;
-	}
+	FightEvent *last = &timeline->lastAttack;
 	timeline->exec = 0;
 	timeline->plan = 0;
-	// Not always an attack, but not null...
-	timeline->lastAttack = timeline->data;
+	// Not an attack, but has a valid end time
+	last->time = 0;
+	last->type = EVENT_NOP;
+	last->duration = 0;
 }
 
-// Deallocate all non null *name in globals
+// Deallocate all non null *name in globals, and the rosters
 void destroyAll() {
+	destroyNames();
+	free(defenders);
+	defenders = NULL;
 	for (int i = 0; i < NUM_SPECIES; i++) {
 		char *name = specData[i].name;
 		if (name != NULL) {
@@ -230,15 +261,6 @@ void destroyAll() {
 	}
 }
 
-// Destroys the timeline object
-void destroyTimeline(Timeline *timeline) {
-	FightEvent *data = timeline->data;
-	if (data != NULL) {
-		free(data);
-		timeline->data = NULL;
-	}
-}
-
 // Calculates the CP of a pokemon
 int getCP(const Pokemon *mon) {
 	Species *spec = &specData[mon->species];
@@ -252,46 +274,61 @@ int getCP(const Pokemon *mon) {
 	return cp;
 }
 
+// Calculates the CP of a species at the level of a pokemon for every IV combination, indexed
+// [ivAttack][ivDefense][ivHP]
+void getCPs(int cp[NUM_IVS * NUM_IVS * NUM_IVS], const Pokemon *mon) {
+	Species *spec = &specData[mon->species];
+	double atk[NUM_IVS], def[NUM_IVS], hp[NUM_IVS], cpml = CPM[mon->level];
+	for (int iv = 0; iv < NUM_IVS; iv++) {
+		atk[iv] = (double)(spec->attack + iv);
+		def[iv] = sqrt((double)(spec->defense + iv));
+		hp[iv] = sqrt((double)(spec->hp + iv));
+	}
+	// Same arithmetic as getCP, one row of HP IVs at a time
+	for (int a = 0; a < NUM_IVS; a++)
+		for (int d = 0; d < NUM_IVS; d++) {
+			int *row = &cp[(a * NUM_IVS + d) * NUM_IVS];
+			for (int h = 0; h < NUM_IVS; h++) {
+				row[h] = (int)floor(atk[a] * def[d] * hp[h] * (cpml * cpml) * 0.1);
+				// Minimum 10 CP
+				if (row[h] < 10) row[h] = 10;
+			}
+		}
+}
+
 // Calculates damage of the specified move - the dodge is not taken into account!
-int getDamage(const Pokemon *attack, const Pokemon *defense, const Move *move, bool dodge) {
+int getDamage(const Pokemon *attack, const Pokemon *defense, const Move *move) {
+	return getRulesDamage(attack, defense, move, &battleRules);
+}
+
+// Calculates damage of the specified move under the given rules, not counting the dodge
+int getRulesDamage(const Pokemon *attack, const Pokemon *defense, const Move *move,
+		const Rules *rules) {
 	/* Attacker's Attack = ( base_attack + attack_IV ) * CPM
 	* Defender's Defense = ( base_defense + defense_IV ) * CPM
 	* Damage = Floor(.5 Attack / Defense * Power * STAB * Weakness) + 1
 	*/
 	Species *atkSpec = &specData[attack->species], *defSpec = &specData[defense->species];
-	int effective = getEffectiveness(move, defSpec);
 	double att = (attack->ivAttack + atkSpec->attack) * CPM[attack->level];
 	double def = (defense->ivDefense + defSpec->defense) * CPM[defense->level];
-	double multipliers = (isSTAB(move, atkSpec) ? MULT_STAB : 1.00);
-	switch (effective) {
-	case 1:
-		// It's super effective!
-		multipliers *= MULT_SUPER;
-		break;
-	case 2:
-		// It's super effective!
-		multipliers *= (MULT_SUPER * MULT_SUPER);
-		break;
-	case -1:
-		// It's not very effective...
-		multipliers *= 1.0 / MULT_SUPER;
-		break;
-	case -2:
-		// It's not very effective...
-		multipliers *= 1.0 / (MULT_SUPER * MULT_SUPER);
-		break;
-	default:
-		// Max 2 advantages
-		break;
+	double multipliers = getMultipliers(move, atkSpec, defSpec, rules);
+	return 1 + (int)floor(0.5 * move->power * att * multipliers / def);
+}
+
+// Same as getRulesDamage for every attack IV of the attacker, or every defense IV of the
+// defender if byDefense is set
+void getRulesDamages(int damage[NUM_IVS], const Pokemon *attack, const Pokemon *defense,
+		const Move *move, const Rules *rules, bool byDefense) {
+	Species *atkSpec = &specData[attack->species], *defSpec = &specData[defense->species];
+	double att[NUM_IVS], def[NUM_IVS], multipliers = getMultipliers(move, atkSpec, defSpec,
+		rules);
+	for (int iv = 0; iv < NUM_IVS; iv++) {
+		att[iv] = ((byDefense ? attack->ivAttack : iv) + atkSpec->attack) * CPM[attack->level];
+		def[iv] = ((byDefense ? iv : defense->ivDefense) + defSpec->defense) *
+			CPM[defense->level];
 	}
-	int damage = 1 + (int)floor(0.5 * move->power * att * multipliers / def);
-#if defined(PRINT_DAMAGE) && defined(_DEBUG)
-	int dodge_d = dodge ? damage * MULT_DODGE : damage;
-	if (dodge_d < 1) dodge_d = 1;
-	printf("%d to %s - %s - %s\n", dodge_d, defSpec->name, move->name, dodge ? "Dodged!" :
-		EFFECT_TEXT[effective + 2]);
-#endif
-	return damage;
+	for (int iv = 0; iv < NUM_IVS; iv++)
+		damage[iv] = 1 + (int)floor(0.5 * move->power * att[iv] * multipliers / def[iv]);
 }
 
 // Calculates the HP of a pokemon
@@ -303,16 +340,19 @@ int getHP(const Pokemon *mon) {
 	return hp;
 }
 
+// Calculates the HP of a species at the level of a pokemon for every HP IV
+void getHPs(int hp[NUM_IVS], const Pokemon *mon) {
+	Species *spec = &specData[mon->species];
+	for (int iv = 0; iv < NUM_IVS; iv++) {
+		hp[iv] = (int)floor((double)(spec->hp + iv) * CPM[mon->level]);
+		// Minimum 10 HP
+		if (hp[iv] < 10) hp[iv] = 10;
+	}
+}
+
 // Gets the move index by its name; case insensitive matching
-// Slow! Do not run in a loop!
 int getMoveName(const char *name) {
-	int move = -1;
-	for (int i = 0; i < MAX_MOVE_INDEX && move < 0; i++) {
-		Move *mv = &moves[i];
-		if (mv->name != NULL && _strcmpi(name, mv->name) == 0)
-			move = i;
-	}
-	return move;
+	return findName(name, false);
 }
 
 // Gets the species index by the # in the pokedex
@@ -332,24 +372,18 @@ int getSpeciesNumber(int number) {
 }
 
 // Gets the species index by its name; case insensitive matching
-// Slow! Do not run in a loop!
 int getSpeciesName(const char *name) {
-	int species = -1;
-	for (int i = 0; i < NUM_SPECIES && species < 0; i++) {
-		Species *spec = &specData[i];
-		if (spec->name != NULL && _strcmpi(name, spec->name) == 0)
-			species = i;
-	}
-	return species;
+	return findName(name, true);
 }
 
-// Initializes the timeline object
-void initTimeline(Timeline *timeline) {
-	FightEvent *data = (FightEvent *)malloc(sizeof(FightEvent) * (size_t)TIMELINE_LEN);
-	timeline->data = data;
-	if (data != NULL)
-		clearTimeline(timeline);
+#ifdef _DEBUG
+// Prints out a damage notification for one hit
+void printDamage(const Pokemon *defense, const Move *move, int damage, bool dodge) {
+	const Species *defSpec = &specData[defense->species];
+	printf("%d to %s - %s - %s\n", damage, defSpec->name, move->name, dodge ? "Dodged!" :
+		EFFECT_TEXT[getEffectiveness(move, defSpec) + 2]);
 }
+#endif
 
 // Prints out a pokemon detail
 void printPokemon(const Pokemon *mon) {
@@ -462,7 +496,10 @@ bool readSpecies() {
 #endif
 		}
 		fclose(fh);
-		done = true;
+		// Names are only looked up through the index
+		done = indexNames();
+		if (!done)
+			puts("Failed to index species data!\r");
 	}
 	return done;
 }
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "policy.h"
+#include "random.h"
+#include "scheduler.h"
+
+// Values of each policy setting in the grid
+static const int DODGE_WAITS[] = { 0, 100, 200, 300, 400 };
+static const int WEAVES[] = { 0, 1, 2, 3, 4, MAX_PLAN_ATTACKS };
+#define NUM_WAITS ((int)(sizeof(DODGE_WAITS) / sizeof(int)))
+#define NUM_WEAVES ((int)(sizeof(WEAVES) / sizeof(int)))
+// Never dodging, plus every other combination of settings
+#define NUM_POLICIES (1 + 3 * NUM_WAITS * NUM_WEAVES * 2)
+
+// A policy still in the running, with its totals over the battles fought so far
+typedef struct _Candidate {
+	Policy policy;
+	// Attacker wins over all the matchups
+	long long wins;
+	// Damage done to the attacker as a fraction of its HP, summed over all the battles
+	double damage;
+	// Position in the grid, which breaks ties
+	int order;
+} Candidate;
+
+// One round of the search: battles from .. to - 1 of every matchup for each candidate left
+typedef struct _PolicyRound {
+	Candidate *cands;
+	const MatchupContext *ctx;
+	int numMatchups;
+	int from;
+	int to;
+	uint64_t seed;
+} PolicyRound;
+
+// Adds battles from .. to - 1 of every matchup to a candidate's totals
+static void addBattles(Candidate *cand, const MatchupContext *ctx, int numMatchups, int from,
+		int to, uint64_t seed) {
+	RepeatBattleResult result;
+	for (int m = 0; m < numMatchups; m++) {
+		// Every policy sees the same defender rolls in the same battle of a matchup
+		repeatFightPolicy(&result, &ctx[m], from, to - from, &cand->policy, deriveSeed(seed,
+			(uint64_t)m));
+		cand->wins += (long long)result.atkWins;
+		cand->damage += result.avgAtkDamage * (double)result.ntimes / (double)ctx[m].atk.hp;
+	}
+}
+
+// Runs one candidate's battles of a round
+static void roundTask(void *context, int task, int worker) {
+	PolicyRound *round = (PolicyRound *)context;
+	(void)worker;
+	addBattles(&round->cands[task], round->ctx, round->numMatchups, round->from, round->to,
+		round->seed);
+}
+
+// Orders candidates with the same battles from best to worst for qsort
+static int compareCandidates(const void *a, const void *b) {
+	const Candidate *ca = (const Candidate *)a, *cb = (const Candidate *)b;
+	int order = ca->order - cb->order;
+	if (ca->wins != cb->wins)
+		order = (ca->wins > cb->wins) ? -1 : 1;
+	else if (ca->damage != cb->damage)
+		order = (ca->damage < cb->damage) ? -1 : 1;
+	return order;
+}
+
+// Fills in every policy of the grid, returning how many there are
+static int buildGrid(Candidate *cands) {
+	int count = 1;
+	// Without dodging, nothing else matters
+	memset(cands, 0, sizeof(Candidate) * NUM_POLICIES);
+	strategyPolicy(&cands[0].policy, STRAT_NO_DODGE);
+	for (int dodge = 1; dodge <= (DODGE_BASIC | DODGE_SPECIAL); dodge++)
+		for (int w = 0; w < NUM_WAITS; w++)
+			for (int q = 0; q < NUM_WEAVES; q++)
+				for (int greedy = 0; greedy < 2; greedy++) {
+					Policy *policy = &cands[count].policy;
+					policy->dodge = dodge;
+					policy->dodgeWait = DODGE_WAITS[w];
+					policy->maxWeave = WEAVES[q];
+					policy->greedy = greedy != 0;
+					count++;
+				}
+	for (int i = 0; i < count; i++)
+		cands[i].order = i;
+	return count;
+}
+
+// Works out a score from a candidate's totals
+static void storeScore(PolicyScore *score, const Candidate *cand, int numMatchups,
+		int battles) {
+	double total = (double)numMatchups * (double)battles;
+	score->winRate = (double)cand->wins / total;
+	score->damage = cand->damage / total;
+	score->battles = battles;
+}
+
+// Scores one policy against the matchups with battles 0 .. battles - 1 of each, seeded the
+// way searchPolicy seeds them (so the same seed fights the same battles as the search)
+void scorePolicy(PolicyScore *score, const Policy *policy, const MatchupContext *ctx,
+		int numMatchups, int battles, uint64_t seed) {
+	Candidate cand;
+	memset(&cand, 0, sizeof(cand));
+	cand.policy = *policy;
+	addBattles(&cand, ctx, numMatchups, 0, battles, seed);
+	storeScore(score, &cand, numMatchups, battles);
+}
+
+// Finds the policy of the grid that does best against the matchups (the highest win rate, then
+// the least damage taken): each round fights twice the battles with the better half of the
+// policies left, until one is left or maxBattles is reached. Every policy fights the same
+// battles on the same contexts, and each round only adds battles. Stores the winner and its
+// score; returns false if the search could not be run
+bool searchPolicy(Policy *best, PolicyScore *score, const MatchupContext *ctx, int numMatchups,
+		int maxBattles, uint64_t seed, int threads) {
+	Candidate *cands = (Candidate *)malloc(sizeof(Candidate) * NUM_POLICIES);
+	PolicyRound round;
+	bool ok = cands != NULL && numMatchups > 0 && maxBattles > 0;
+	if (ok) {
+		int alive = buildGrid(cands);
+		round.cands = cands;
+		round.ctx = ctx;
+		round.numMatchups = numMatchups;
+		round.from = 0;
+		round.to = (maxBattles < POLICY_START_BATTLES) ? maxBattles : POLICY_START_BATTLES;
+		round.seed = seed;
+		while (ok && round.from < round.to) {
+			ok = runTasks(roundTask, &round, alive, threads);
+			// The best candidates move to the front
+			qsort(cands, (size_t)alive, sizeof(Candidate), compareCandidates);
+			round.from = round.to;
+			if (alive > 1) {
+				alive = (alive + 1) >> 1;
+				round.to = (round.to > maxBattles >> 1) ? maxBattles : round.to << 1;
+			}
+			if (alive <= 1)
+				round.to = round.from;
+		}
+		*best = cands[0].policy;
+		storeScore(score, &cands[0], numMatchups, round.from);
+	}
+	free(cands);
+	return ok;
+}
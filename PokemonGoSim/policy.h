@@ -0,0 +1,31 @@
+#pragma once
+
+// Search for the attacker planner policy that does best against a set of matchups, by
+// successive halving over a grid of policies
+
+#include "battle.h"
+
+// Battles per matchup that every policy of the grid gets in the first round
+#define POLICY_START_BATTLES 64
+
+// How well a policy did against a set of matchups, each counting the same
+typedef struct _PolicyScore {
+	// Average win rate
+	double winRate;
+	// Average damage done to the attacker as a fraction of its HP
+	double damage;
+	// Battles per matchup
+	int battles;
+} PolicyScore;
+
+// Scores one policy against the matchups with battles 0 .. battles - 1 of each, seeded the
+// way searchPolicy seeds them (so the same seed fights the same battles as the search)
+void scorePolicy(PolicyScore *score, const Policy *policy, const MatchupContext *ctx,
+	int numMatchups, int battles, uint64_t seed);
+// Finds the policy of the grid that does best against the matchups (the highest win rate, then
+// the least damage taken): each round fights twice the battles with the better half of the
+// policies left, until one is left or maxBattles is reached. Every policy fights the same
+// battles on the same contexts, and each round only adds battles. Stores the winner and its
+// score; returns false if the search could not be run
+bool searchPolicy(Policy *best, PolicyScore *score, const MatchupContext *ctx, int numMatchups,
+	int maxBattles, uint64_t seed, int threads);
@@ -0,0 +1,43 @@
+#pragma once
+
+// Counter-based random numbers: each value is a hash of (stream key, draw number), so every
+// (seed, stream) pair gives its own reproducible sequence no matter which thread draws it, and
+// jumping ahead is free
+
+// Added to the counter on each draw (2^64 / golden ratio)
+#define RANDOM_GAMMA 0x9E3779B97F4A7C15ULL
+
+typedef struct _Random {
+	// Stream key derived from the seed and stream number
+	uint64_t key;
+	// Number of values drawn so far
+	uint64_t counter;
+} Random;
+
+// Scrambles all 64 bits of the input (SplitMix64 finalizer)
+static inline uint64_t mixRandom(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+// Derives the seed for sub-task "id" of a run with the given seed
+static inline uint64_t deriveSeed(uint64_t seed, uint64_t id) {
+	return mixRandom(seed + RANDOM_GAMMA * (id + 1ULL));
+}
+
+// Skips the next n values
+static inline void jumpRandom(Random *rng, uint64_t n) {
+	rng->counter += n;
+}
+
+// Draws the next 32 random bits
+static inline uint32_t nextRandom(Random *rng) {
+	return (uint32_t)(mixRandom(rng->key + RANDOM_GAMMA * ++rng->counter) >> 32);
+}
+
+// Starts the sequence numbered "stream" of the given seed
+static inline void seedRandom(Random *rng, uint64_t seed, uint64_t stream) {
+	rng->key = mixRandom(seed ^ mixRandom(stream + RANDOM_GAMMA));
+	rng->counter = 0ULL;
+}
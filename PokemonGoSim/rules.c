@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include "rules.h"
+
+// Longest rule name in a rules file
+#define RULE_NAME_MAX 32U
+
+// Where a rule named in a rules file is stored
+typedef struct _RuleField {
+	// Name of the constant in pokemon.h
+	const char *name;
+	// Offset of the field in Rules
+	size_t offset;
+	// Whether the field is a double rather than an int
+	bool real;
+	// Smallest and largest value allowed
+	double min;
+	double max;
+} RuleField;
+
+// Every rule that a rules file can set
+static const RuleField RULE_FIELDS[] = {
+	{ "MULT_STAB", offsetof(Rules, multStab), true, 0.0, 100.0 },
+	{ "MULT_SUPER", offsetof(Rules, multSuper), true, 0.01, 100.0 },
+	{ "HP_TO_ENERGY", offsetof(Rules, hpToEnergy), false, 1.0, 10000.0 },
+	{ "DODGE_PERCENT", offsetof(Rules, dodgePercent), false, 0.0, 100.0 },
+	{ "DODGE_TIME", offsetof(Rules, dodgeTime), false, 0.0, 10000.0 },
+	{ "DODGE_WAIT", offsetof(Rules, dodgeWait), false, 0.0, 10000.0 },
+	{ "CHARGE_TIME", offsetof(Rules, chargeTime), false, 0.0, 10000.0 },
+	{ "ATK_DELAY", offsetof(Rules, atkDelay), false, 0.0, 10000.0 },
+	{ "ATK_HP_MULT", offsetof(Rules, atkHPMult), false, 1.0, 100.0 },
+	{ "ATK_NRG_MAX", offsetof(Rules, atkNRGMax), false, 1.0, 10000.0 },
+	{ "DEF_DELAY", offsetof(Rules, defDelay), false, 0.0, 10000.0 },
+	{ "DEF_DELAY_RANGE", offsetof(Rules, defDelayRange), false, 0.0, MAX_DELAY_RANGE },
+	{ "DEF_HP_MULT", offsetof(Rules, defHPMult), false, 1.0, 100.0 },
+	{ "DEF_NRG_MAX", offsetof(Rules, defNRGMax), false, 1.0, 10000.0 },
+	{ "DEF_PROB", offsetof(Rules, defProb), false, 0.0, 65536.0 },
+	{ "MAX_TIME", offsetof(Rules, maxTime), false, 1.0, 3600000.0 }
+};
+
+// Rules of every battle fought (DEFAULT_RULES unless a rules file was read)
+Rules battleRules = DEFAULT_RULES;
+
+// Number of rules that a rules file can set
+#define NUM_RULES ((int)(sizeof(RULE_FIELDS) / sizeof(RuleField)))
+
+// Reports true if a rule set is the same as DEFAULT_RULES
+bool isDefaultRules(const Rules *rules) {
+	return memcmp(rules, &DEFAULT_RULES, sizeof(Rules)) == 0;
+}
+
+// Reports true if matchups set up under either rule set get the same combatant tables, so that
+// only the battle loop tells them apart
+bool sameTableRules(const Rules *a, const Rules *b) {
+	return a->multStab == b->multStab && a->multSuper == b->multSuper && a->dodgePercent ==
+		b->dodgePercent && a->atkHPMult == b->atkHPMult && a->atkNRGMax == b->atkNRGMax &&
+		a->defHPMult == b->defHPMult && a->defNRGMax == b->defNRGMax;
+}
+
+// Finds a rule by its name in pokemon.h, returning its index or -1 if there is no such rule
+int findRule(const char *name) {
+	int rule = -1;
+	for (int i = 0; i < NUM_RULES && rule < 0; i++)
+		if (strcmp(RULE_FIELDS[i].name, name) == 0)
+			rule = i;
+	return rule;
+}
+
+// Gets the name of a rule found by findRule
+const char * ruleName(int rule) {
+	return RULE_FIELDS[rule].name;
+}
+
+// Sets a rule found by findRule; returns false if the value is out of range for it
+bool setRule(Rules *rules, int rule, double value) {
+	const RuleField *field = &RULE_FIELDS[rule];
+	char *at = (char *)rules + field->offset;
+	bool ok = value >= field->min && value <= field->max;
+	if (ok && field->real)
+		*(double *)at = value;
+	else if (ok)
+		*(int *)at = (int)floor(value + 0.5);
+	return ok;
+}
+
+// Reads "NAME value" lines (NAME being a constant from pokemon.h) from a rules file into
+// battleRules, starting from DEFAULT_RULES; returns false if the file is missing or not valid
+bool readRules(const char *fileName) {
+	Rules rules = DEFAULT_RULES;
+	FILE *fh;
+	bool ok = false;
+	if (fopen_s(&fh, fileName, "r") == 0 && fh != NULL) {
+		char name[RULE_NAME_MAX];
+		double value;
+		int read;
+		ok = true;
+		while (ok && 2 == (read = fscanf_s(fh, "%31s %lf ", name, RULE_NAME_MAX, &value))) {
+			int rule = findRule(name);
+			ok = rule >= 0 && setRule(&rules, rule, value);
+			if (!ok)
+				printf("Bad rule: %s %g\n", name, value);
+		}
+		// Anything left over is not a rule
+		ok = ok && read == EOF;
+		fclose(fh);
+	}
+	if (ok)
+		battleRules = rules;
+	else
+		printf("Failed to load rules from %s!\n", fileName);
+	return ok;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Battle rules that can be changed at run time from a rules file; the battle kernels are
+// specialized for DEFAULT_RULES so that the usual rules stay compile-time constants
+
+#include "pokemon.h"
+
+// Most ms added to DEF_DELAY by a defender delay roll, which keeps the roll in an int
+#define MAX_DELAY_RANGE 30000
+
+// Every number the battle engines take from the rules (doubles first, so that there is no
+// padding and two rule sets can be compared with memcmp)
+typedef struct _Rules {
+	// Multiplier for STAB
+	double multStab;
+	// Multiplier for Super Effective (1/x for Not Very Effective)
+	double multSuper;
+	// After this many HP lost, the victim will gain 1 energy
+	int hpToEnergy;
+	// Percent of the damage still done to a dodging attacker
+	int dodgePercent;
+	// Time taken to dodge
+	int dodgeTime;
+	// Time before the dodge window closes that a late dodge starts
+	int dodgeWait;
+	// Time taken to charge special attack
+	int chargeTime;
+	// Delay after each attacker basic attack
+	int atkDelay;
+	// Attacker HP multiplier and max NRG
+	int atkHPMult;
+	int atkNRGMax;
+	// Delay time on defender (min and range)
+	int defDelay;
+	int defDelayRange;
+	// Defender HP multiplier and max NRG
+	int defHPMult;
+	int defNRGMax;
+	// Defender probability of using special if energy available, out of 65536
+	int defProb;
+	// Battle length
+	int maxTime;
+} Rules;
+
+// Rules given by the constants in pokemon.h
+static const Rules DEFAULT_RULES = {
+	MULT_STAB, MULT_SUPER, HP_TO_ENERGY, DODGE_PERCENT, DODGE_TIME, DODGE_WAIT, CHARGE_TIME,
+	ATK_DELAY, ATK_HP_MULT, ATK_NRG_MAX, DEF_DELAY, DEF_DELAY_RANGE, DEF_HP_MULT, DEF_NRG_MAX,
+	DEF_PROB, MAX_TIME
+};
+
+// Rules of every battle fought (DEFAULT_RULES unless a rules file was read)
+extern Rules battleRules;
+
+// Calculates damage of the specified move under the given rules, not counting the dodge
+int getRulesDamage(const Pokemon *attack, const Pokemon *defense, const Move *move,
+	const Rules *rules);
+// Same as getRulesDamage for every attack IV of the attacker, or every defense IV of the
+// defender if byDefense is set
+void getRulesDamages(int damage[NUM_IVS], const Pokemon *attack, const Pokemon *defense,
+	const Move *move, const Rules *rules, bool byDefense);
+// Finds a rule by its name in pokemon.h, returning its index or -1 if there is no such rule
+int findRule(const char *name);
+// Reports true if a rule set is the same as DEFAULT_RULES
+bool isDefaultRules(const Rules *rules);
+// Gets the name of a rule found by findRule
+const char * ruleName(int rule);
+// Reports true if matchups set up under either rule set get the same combatant tables, so that
+// only the battle loop tells them apart
+bool sameTableRules(const Rules *a, const Rules *b);
+// Sets a rule found by findRule; returns false if the value is out of range for it
+bool setRule(Rules *rules, int rule, double value);
+// Reads "NAME value" lines (NAME being a constant from pokemon.h) from a rules file into
+// battleRules, starting from DEFAULT_RULES; returns false if the file is missing or not valid
+bool readRules(const char *fileName);
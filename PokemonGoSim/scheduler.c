@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "platform.h"
+#include "scheduler.h"
+
+// Tasks not yet run by one worker; the owner takes from the front, thieves from the back
+typedef struct _TaskRange {
+	// Protects next and end
+	Mutex lock;
+	// Next task to run
+	int next;
+	// One past the last task to run
+	int end;
+	// Keeps each worker's range on its own cache line
+	char pad[64];
+} TaskRange;
+
+typedef struct _Scheduler {
+	// Task callback and its argument
+	TaskFunc func;
+	void *context;
+	// One range per worker
+	TaskRange *ranges;
+	// Number of workers
+	int workers;
+} Scheduler;
+
+typedef struct _Worker {
+	// Shared scheduler
+	Scheduler *sched;
+	// Index of this worker
+	int id;
+} Worker;
+
+// Takes the next task from the front of a worker's own range, or -1 if it is empty
+static int popTask(TaskRange *range) {
+	int task = -1;
+	lockMutex(&range->lock);
+	if (range->next < range->end)
+		task = range->next++;
+	unlockMutex(&range->lock);
+	return task;
+}
+
+// Steals the back half of another worker's range into this one, returning the first stolen
+// task to run now, or -1 if every range is empty
+static int stealTask(Scheduler *sched, int id) {
+	int task = -1, end = 0, workers = sched->workers;
+	for (int i = 1; i < workers && task < 0; i++) {
+		TaskRange *victim = &sched->ranges[(id + i) % workers];
+		lockMutex(&victim->lock);
+		int left = victim->end - victim->next;
+		if (left > 0) {
+			// Round up so that a single remaining task can be stolen
+			end = victim->end;
+			task = end - ((left + 1) >> 1);
+			victim->end = task;
+		}
+		unlockMutex(&victim->lock);
+	}
+	if (task >= 0) {
+		// Keep the rest of the loot where other thieves can find it
+		TaskRange *own = &sched->ranges[id];
+		lockMutex(&own->lock);
+		own->next = task + 1;
+		own->end = end;
+		unlockMutex(&own->lock);
+	}
+	return task;
+}
+
+// Runs tasks until every range is empty
+static void runWorker(Scheduler *sched, int id) {
+	TaskRange *own = &sched->ranges[id];
+	int task;
+	while ((task = popTask(own)) >= 0 || (task = stealTask(sched, id)) >= 0)
+		sched->func(sched->context, task, id);
+}
+
+// Thread entry point for workers other than the calling thread
+static THREAD_PROC(workerThread, arg) {
+	Worker *worker = (Worker *)arg;
+	runWorker(worker->sched, worker->id);
+	return THREAD_DONE;
+}
+
+// Reports how many workers runTasks uses when asked for 0 workers (one per core)
+int defaultWorkers() {
+	return getNumCores();
+}
+
+// Runs tasks 0 .. count - 1 on the specified number of workers (0 = one per core) and returns
+// when all are complete; returns false if the tasks could not be run
+bool runTasks(TaskFunc func, void *context, int count, int workers) {
+	Scheduler sched;
+	Worker *info;
+	Thread *threads;
+	bool ok = false;
+	if (workers <= 0)
+		workers = defaultWorkers();
+	// No use having more workers than tasks
+	if (workers > count)
+		workers = count;
+	if (count <= 0)
+		return true;
+	sched.func = func;
+	sched.context = context;
+	sched.workers = workers;
+	sched.ranges = (TaskRange *)malloc(sizeof(TaskRange) * (size_t)workers);
+	info = (Worker *)malloc(sizeof(Worker) * (size_t)workers);
+	threads = (Thread *)malloc(sizeof(Thread) * (size_t)workers);
+	if (sched.ranges != NULL && info != NULL && threads != NULL) {
+		int started = 1;
+		// Deal out equal contiguous slices; stealing evens out the long battles later
+		for (int i = 0; i < workers; i++) {
+			TaskRange *range = &sched.ranges[i];
+			initMutex(&range->lock);
+			range->next = (int)((long long)count * i / workers);
+			range->end = (int)((long long)count * (i + 1) / workers);
+			info[i].sched = &sched;
+			info[i].id = i;
+		}
+		// The calling thread is worker 0; if a thread fails to start, the others steal its work
+		for (int i = 1; i < workers; i++)
+			if (startThread(&threads[started], workerThread, &info[i]))
+				started++;
+		runWorker(&sched, 0);
+		for (int i = 1; i < started; i++)
+			joinThread(threads[i]);
+		for (int i = 0; i < workers; i++)
+			destroyMutex(&sched.ranges[i].lock);
+		ok = true;
+	}
+	free(threads);
+	free(info);
+	free(sched.ranges);
+	return ok;
+}
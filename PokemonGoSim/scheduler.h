@@ -0,0 +1,13 @@
+#pragma once
+
+// Runs a fixed set of independent tasks across all cores, balancing the load by work stealing
+
+// Runs one task; worker is the index (0 .. workers - 1) of the thread running it, so that
+// per-thread state can be kept in arrays
+typedef void (*TaskFunc)(void *context, int task, int worker);
+
+// Reports how many workers runTasks uses when asked for 0 workers (one per core)
+int defaultWorkers();
+// Runs tasks 0 .. count - 1 on the specified number of workers (0 = one per core) and returns
+// when all are complete; returns false if the tasks could not be run
+bool runTasks(TaskFunc func, void *context, int count, int workers);
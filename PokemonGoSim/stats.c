@@ -0,0 +1,46 @@
+#include "stdafx.h"
+#include "stats.h"
+
+#ifdef BATTLE_STATS
+// Counters of the calling thread
+THREAD_LOCAL BattleStats threadStats;
+
+// Adds one set of counters to another
+void addStats(BattleStats *totals, const BattleStats *stats) {
+	totals->battles += stats->battles;
+	totals->events += stats->events;
+	totals->time += stats->time;
+	totals->nopSkips += stats->nopSkips;
+	totals->atkPlans += stats->atkPlans;
+	totals->defPlans += stats->defPlans;
+	totals->dodges += stats->dodges;
+	totals->dodgeHits += stats->dodgeHits;
+	if (stats->maxQueued > totals->maxQueued)
+		totals->maxQueued = stats->maxQueued;
+}
+
+// Adds the calling thread's counters to the totals and clears them
+void collectStats(BattleStats *totals) {
+	addStats(totals, &threadStats);
+	memset(&threadStats, 0, sizeof(threadStats));
+}
+
+// Prints the totals of a run
+void printStats(const BattleStats *stats, double seconds) {
+	// Avoid dividing by zero if nothing was fought
+	double battles = (stats->battles > 0LL) ? (double)stats->battles : 1.0;
+	printf("-- Battle stats --\n");
+	printf("Battles: %lld in %.2f s (%.0f per second)\n", stats->battles, seconds,
+		(double)stats->battles / seconds);
+	printf("Events: %lld (%.1f per battle)\n", stats->events, (double)stats->events /
+		battles);
+	printf("Simulated time: %.1f s per battle\n", (double)stats->time * 0.001 / battles);
+	printf("Plans: %.1f attacker, %.1f defender per battle\n", (double)stats->atkPlans /
+		battles, (double)stats->defPlans / battles);
+	printf("Waits skipped looking ahead: %.1f per battle\n", (double)stats->nopSkips / battles);
+	printf("Dodges: %.1f per battle, %.1f%% caught an attack\n", (double)stats->dodges /
+		battles, 100.0 * (double)stats->dodgeHits / ((stats->dodges > 0LL) ?
+		(double)stats->dodges : 1.0));
+	printf("Most events queued in a timeline: %d of %d\n\n", stats->maxQueued, TIMELINE_LEN);
+}
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+// Hot path counters of the battle engines, compiled in with BATTLE_STATS; each thread counts
+// into its own copy, which is collected after every matchup
+
+#include "pokemon.h"
+
+typedef struct _BattleStats {
+	// Battles finished
+	long long battles;
+	// Events executed by both sides
+	long long events;
+	// Simulated time in ms
+	long long time;
+	// Wait events skipped by planEvent while looking for the next defender attack
+	long long nopSkips;
+	// Calls to the attacker and defender planners
+	long long atkPlans;
+	long long defPlans;
+	// Dodges planned by the attacker, and defender attacks that landed during one
+	long long dodges;
+	long long dodgeHits;
+	// Most events waiting in one timeline right after planning
+	int maxQueued;
+} BattleStats;
+
+#ifdef BATTLE_STATS
+#include "platform.h"
+
+// Counters of the calling thread
+extern THREAD_LOCAL BattleStats threadStats;
+
+// Adds to a counter of the calling thread
+#define STAT_ADD(_field, _value) (threadStats._field += (_value))
+// Counts a finished battle from its timelines and end time
+#define STAT_BATTLE(_atkTL, _defTL, _now) (threadStats.battles++, threadStats.events += \
+	(long long)(_atkTL)->exec + (long long)(_defTL)->exec, threadStats.time += (_now))
+// Raises the timeline high-water mark to the events left in a timeline
+#define STAT_QUEUED(_tl) if ((_tl)->plan - (_tl)->exec > threadStats.maxQueued) \
+	threadStats.maxQueued = (_tl)->plan - (_tl)->exec
+
+// Adds one set of counters to another
+void addStats(BattleStats *totals, const BattleStats *stats);
+// Adds the calling thread's counters to the totals and clears them
+void collectStats(BattleStats *totals);
+// Prints the totals of a run
+void printStats(const BattleStats *stats, double seconds);
+#else
+#define STAT_ADD(_field, _value) ((void)0)
+#define STAT_BATTLE(_atkTL, _defTL, _now) ((void)0)
+#define STAT_QUEUED(_tl) ((void)0)
+#endif
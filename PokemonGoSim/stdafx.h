@@ -5,13 +5,42 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
+#endif
 
-#define _CRT_RAND_S
+#include <limits.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef _WIN32
 #include <tchar.h>
+#else
+#include <strings.h>
+
+// Secure CRT names used by the data readers, implemented in platform.c
+#define _strcmpi strcasecmp
+#define _strnicmp strncasecmp
+#define fscanf_s compatScanf
+#define fopen_s(_fh, _name, _mode) ((*(_fh) = fopen((_name), (_mode))) == NULL ? -1 : 0)
+#define strcpy_s(_dest, _size, _src) strncpy((_dest), (_src), (_size))
+
+// fscanf_s replacement: converts the buffer sizes after %s, %c and %[ into field widths
+int compatScanf(FILE *fh, const char *format, ...);
+#endif
+
+#ifdef COUNT_ALLOCATIONS
+// Heap allocations are counted for the benchmark, by wrappers implemented in platform.c
+void * countedCalloc(size_t count, size_t size);
+void * countedMalloc(size_t size);
+void * countedRealloc(void *ptr, size_t size);
+// Reports the number of heap allocations made so far by all threads
+long long getAllocations();
+#define calloc countedCalloc
+#define malloc countedMalloc
+#define realloc countedRealloc
+#endif
@@ -0,0 +1,132 @@
+#include "stdafx.h"
+#include "matrix.h"
+#include "stream.h"
+
+// Positions wrap around the ring with this mask
+#define STREAM_MASK (STREAM_SLOTS - 1)
+
+// Writes a name as a JSON string
+static void writeJsonName(FILE *fh, const char *name) {
+	fputc('"', fh);
+	for (; *name != '\0'; name++) {
+		if (*name == '"' || *name == '\\')
+			fputc('\\', fh);
+		fputc(*name, fh);
+	}
+	fputc('"', fh);
+}
+
+// Writes one pokemon as JSON fields with the species and move names
+static void writeJsonPokemon(FILE *fh, const char *side, const Pokemon *mon) {
+	fprintf(fh, "\"%s\":", side);
+	writeJsonName(fh, specData[mon->species].name);
+	fprintf(fh, ",\"%sBasic\":", side);
+	writeJsonName(fh, moves[mon->basicMove].name);
+	fprintf(fh, ",\"%sCharge\":", side);
+	writeJsonName(fh, moves[mon->powerMove].name);
+	fputc(',', fh);
+}
+
+// Writes one matchup as a line of JSON with the same fields as a CSV matrix
+static bool writeJsonMatchup(FILE *fh, int strategy, const RepeatBattleResult *result) {
+	fprintf(fh, "{\"strategy\":%d,", strategy);
+	writeJsonPokemon(fh, "attacker", result->attacking);
+	writeJsonPokemon(fh, "defender", result->defending);
+	return fprintf(fh, "\"winRate\":%.5f,\"winError\":%.5f,\"attackerDamage\":%.2f,"
+		"\"defenderDamage\":%.2f,\"timeLeft\":%.0f,\"battles\":%d}\n", result->winRate,
+		result->winError, result->avgAtkDamage, result->avgDefDamage, result->avgTimeLeft,
+		result->ntimes) > 0;
+}
+
+// Writes queued matchups in the order they were queued until the stream is closed and empty,
+// flushing whenever the queue runs dry so that readers see whole lines without much delay
+static THREAD_PROC(streamWriter, arg) {
+	ResultStream *stream = (ResultStream *)arg;
+	bool pending = false, done = false;
+	while (!done) {
+		StreamSlot *slot = &stream->slots[stream->tail & STREAM_MASK];
+		// Checked first, as nothing can be queued after it is set
+		bool closed = atomicLoad(&stream->closed) != 0LL;
+		if (atomicLoad(&slot->seq) == stream->tail + 1LL) {
+			const RepeatBattleResult *result = &slot->result;
+			if (stream->ok)
+				stream->ok = stream->csv ? writeCsvMatchup(stream->fh, slot->strategy,
+					result->attacking, result->defending, result) : writeJsonMatchup(
+					stream->fh, slot->strategy, result);
+			// Hand the slot back for the next lap around the ring
+			atomicStore(&slot->seq, stream->tail + STREAM_SLOTS);
+			stream->tail++;
+			stream->written++;
+			pending = true;
+		} else if (pending) {
+			stream->ok = fflush(stream->fh) == 0 && stream->ok;
+			pending = false;
+		} else if (closed)
+			done = true;
+		else
+			sleepMillis(STREAM_IDLE);
+	}
+	return THREAD_DONE;
+}
+
+// Creates the file (CSV if the name ends in .csv, or else one JSON object per line) and starts
+// the thread that writes to it; returns false if either failed
+bool openStream(ResultStream *stream, const char *fileName) {
+	size_t len = strlen(fileName);
+	bool ok = false;
+	stream->slots = (StreamSlot *)malloc(sizeof(StreamSlot) * STREAM_SLOTS);
+	stream->head = 0LL;
+	stream->tail = 0LL;
+	stream->closed = 0LL;
+	stream->fh = NULL;
+	stream->csv = len >= 4U && _strcmpi(&fileName[len - 4U], ".csv") == 0;
+	stream->ok = true;
+	stream->written = 0LL;
+	if (stream->slots != NULL && fopen_s(&stream->fh, fileName, "w") == 0 && stream->fh !=
+			NULL) {
+		for (int i = 0; i < STREAM_SLOTS; i++)
+			stream->slots[i].seq = (long long)i;
+		if (!stream->csv || fputs(MATRIX_CSV_HEADER, stream->fh) >= 0)
+			ok = startThread(&stream->writer, streamWriter, stream);
+		if (!ok)
+			fclose(stream->fh);
+	}
+	if (!ok)
+		free(stream->slots);
+	return ok;
+}
+
+// Queues a finished matchup to be written; safe to call from any number of threads at once
+void pushResult(ResultStream *stream, int strategy, const RepeatBattleResult *result) {
+	StreamSlot *slot = NULL;
+	long long pos = 0LL;
+	while (slot == NULL) {
+		pos = atomicLoad(&stream->head);
+		StreamSlot *next = &stream->slots[pos & STREAM_MASK];
+		long long seq = atomicLoad(&next->seq);
+		if (seq == pos) {
+			// Free for this lap; claim it unless another worker got there first
+			if (atomicSwap(&stream->head, pos, pos + 1LL))
+				slot = next;
+		} else if (seq < pos)
+			// Still holds a matchup from the last lap, so the ring is full
+			sleepMillis(0);
+	}
+	slot->strategy = strategy;
+	slot->result = *result;
+	// Now the writer may take it
+	atomicStore(&slot->seq, pos + 1LL);
+}
+
+// Waits for every queued matchup to be written and closes the file; returns false if anything
+// could not be written
+bool closeStream(ResultStream *stream) {
+	bool ok;
+	atomicStore(&stream->closed, 1LL);
+	joinThread(stream->writer);
+	ok = fclose(stream->fh) == 0 && stream->ok;
+	free(stream->slots);
+	stream->slots = NULL;
+	stream->fh = NULL;
+	return ok;
+}
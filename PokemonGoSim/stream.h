@@ -0,0 +1,52 @@
+#pragma once
+
+// Results written out by a background thread as each matchup finishes, so that a sweep needs the
+// same memory however many matchups it runs and the file can be read while the sweep goes on
+
+#include "platform.h"
+#include "pokemon.h"
+
+// Matchups that can wait to be written (a power of 2); workers wait for room if the writer
+// falls behind
+#define STREAM_SLOTS 4096
+// Time in ms that the writer sleeps when there is nothing to write
+#define STREAM_IDLE 5
+
+// One finished matchup waiting in the queue
+typedef struct _StreamSlot {
+	// Position this slot may be filled at, plus one once it has been filled
+	volatile long long seq;
+	// STRAT_x that the matchup was fought with
+	int strategy;
+	RepeatBattleResult result;
+} StreamSlot;
+
+typedef struct _ResultStream {
+	// Ring of STREAM_SLOTS matchups
+	StreamSlot *slots;
+	// Next position to fill, claimed by the workers
+	volatile long long head;
+	// Keeps the workers' position off the writer's cache line
+	char pad[64];
+	// Next position to write, only moved by the writer
+	long long tail;
+	// Set once no more matchups will be added
+	volatile long long closed;
+	// Output file, and whether it is CSV rather than NDJSON
+	FILE *fh;
+	bool csv;
+	// False once a write has failed
+	bool ok;
+	// Matchups written so far
+	long long written;
+	Thread writer;
+} ResultStream;
+
+// Creates the file (CSV if the name ends in .csv, or else one JSON object per line) and starts
+// the thread that writes to it; returns false if either failed
+bool openStream(ResultStream *stream, const char *fileName);
+// Queues a finished matchup to be written; safe to call from any number of threads at once
+void pushResult(ResultStream *stream, int strategy, const RepeatBattleResult *result);
+// Waits for every queued matchup to be written and closes the file; returns false if anything
+// could not be written
+bool closeStream(ResultStream *stream);
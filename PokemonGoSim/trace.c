@@ -0,0 +1,136 @@
+#include "stdafx.h"
+// The replay always records, whether or not the engines are built with BATTLE_TRACE
+#ifndef BATTLE_TRACE
+#define BATTLE_TRACE
+#endif
+#include "engine.h"
+#include "trace.h"
+
+// First bytes of every trace file
+static const char TRACE_MAGIC[8] = { 'P', 'G', 'S', 'T', 'R', 'A', 'C', 'E' };
+// Names of the EVENT_x types and of the sides
+static const char * const EVENT_NAMES[NUM_EVENTS] = { "wait", "basic", "special", "dodge" };
+static const char * const SIDE_NAMES[] = { "Attacker", "Defender" };
+
+// Records of the calling thread
+THREAD_LOCAL TraceRing threadTrace;
+
+// Clears the calling thread's ring
+void clearTrace() {
+	threadTrace.count = 0LL;
+}
+
+// Fights battle number info->battle of the matchup (seeded with info->seed as repeatFight
+// seeds it) while recording it, and stores the result in the info
+void replayBattle(TraceInfo *info) {
+	MatchupContext ctx;
+	BattleResult setup;
+	BattleStatus atk, def;
+	Timeline atkTL, defTL;
+	Random rng;
+	int now;
+	initMatchup(&ctx, &info->attacker, &info->defender);
+	setup.attacking = ctx.atk.mon;
+	setup.defending = ctx.def.mon;
+	seedRandom(&rng, info->seed, (uint64_t)info->battle);
+	clearTrace();
+	// Same steps as doFight
+	clearTimeline(&atkTL);
+	initBattle(&atk, &ctx.atk, ctx.rules, &atkTL, NULL);
+	initBattle(&def, &ctx.def, ctx.rules, &defTL, &rng);
+	defenderStart(&def);
+	now = battleLoop(&atk, &def, info->strategy, NULL, false, ctx.rules->maxTime);
+	info->result = battleResult(&setup, now, &atk, &def);
+}
+
+// Writes the calling thread's ring and the battle it holds to a file; returns false if the
+// file could not be written
+bool writeTrace(const char *fileName, const TraceInfo *info) {
+	FILE *fh;
+	bool ok = false;
+	if (fopen_s(&fh, fileName, "wb") == 0 && fh != NULL) {
+		long long count = threadTrace.count, first = (count > TRACE_RECORDS) ? count -
+			TRACE_RECORDS : 0LL;
+		ok = fwrite(TRACE_MAGIC, sizeof(TRACE_MAGIC), 1, fh) == 1 && fwrite(info,
+			sizeof(TraceInfo), 1, fh) == 1 && fwrite(&count, sizeof(count), 1, fh) == 1;
+		// Oldest first
+		for (long long i = first; i < count && ok; i++)
+			ok = fwrite(&threadTrace.records[i & TRACE_MASK], sizeof(TraceRecord), 1, fh) == 1;
+		ok = fclose(fh) == 0 && ok;
+	}
+	return ok;
+}
+
+// Reports true if a pokemon read from a trace file is one the game data has, so that its
+// names can be printed
+static bool validMon(const Pokemon *mon) {
+	return mon->species >= 0 && mon->species < NUM_SPECIES && mon->basicMove >= 0 &&
+		mon->basicMove < MAX_MOVE_INDEX && moves[mon->basicMove].name != NULL &&
+		mon->powerMove >= 0 && mon->powerMove < MAX_MOVE_INDEX &&
+		moves[mon->powerMove].name != NULL;
+}
+
+// Prints one record of a trace of the matchup
+static void printRecord(const TraceRecord *rec, const TraceInfo *info) {
+	const Pokemon *mon = (rec->side == TRACE_ATTACKER) ? &info->attacker : &info->defender;
+	const char *name = SIDE_NAMES[rec->side & 1U], *event = (rec->type < NUM_EVENTS) ?
+		EVENT_NAMES[rec->type] : "?";
+	printf("[ %05d ] ", rec->time);
+	switch (rec->kind) {
+	case RECORD_START:
+		printf("Battle starts, defender has %d HP\n", rec->value);
+		break;
+	case RECORD_PLAN:
+		printf("%s plans %d events, %d energy\n", name, rec->value, rec->extra);
+		break;
+	case RECORD_QUEUE:
+		printf("  %s queued %s for %d\n", name, event, rec->value);
+		break;
+	case RECORD_EXECUTE:
+	case RECORD_DODGED:
+		if (rec->type == EVENT_BASIC || rec->type == EVENT_SPECIAL)
+			printf("%s used %s for %d damage%s (%d total)\n", name, moves[(rec->type ==
+				EVENT_BASIC) ? mon->basicMove : mon->powerMove].name, rec->value,
+				(rec->kind == RECORD_DODGED) ? ", dodged" : "", rec->extra);
+		else
+			printf("%s executed %s\n", name, event);
+		break;
+	case RECORD_DRAW:
+		printf("Defender drew %d\n", rec->value);
+		break;
+	case RECORD_END:
+		printf("Battle over, %s\n", (rec->value > 0) ? "attacker won" : "defender won");
+		break;
+	default:
+		printf("Unknown record %d\n", (int)rec->kind);
+		break;
+	}
+}
+
+// Decodes a trace file and prints every record in it; returns false if the file is not a
+// valid trace
+bool printTrace(const char *fileName) {
+	FILE *fh;
+	bool ok = false;
+	if (fopen_s(&fh, fileName, "rb") == 0 && fh != NULL) {
+		char magic[sizeof(TRACE_MAGIC)];
+		TraceInfo info;
+		TraceRecord rec;
+		long long count;
+		ok = fread(magic, sizeof(magic), 1, fh) == 1 && memcmp(magic, TRACE_MAGIC,
+			sizeof(magic)) == 0 && fread(&info, sizeof(info), 1, fh) == 1 && fread(&count,
+			sizeof(count), 1, fh) == 1 && validMon(&info.attacker) && validMon(&info.defender);
+		if (ok) {
+			printf("-- Battle %d of %s [%s / %s] VS %s [%s / %s] --\n", info.battle,
+				specData[info.attacker.species].name, moves[info.attacker.basicMove].name,
+				moves[info.attacker.powerMove].name, specData[info.defender.species].name,
+				moves[info.defender.basicMove].name, moves[info.defender.powerMove].name);
+			if (count > TRACE_RECORDS)
+				printf("(The first %lld records were overwritten)\n", count - TRACE_RECORDS);
+		}
+		while (ok && fread(&rec, sizeof(rec), 1, fh) == 1)
+			printRecord(&rec, &info);
+		fclose(fh);
+	}
+	return ok;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+// Compact binary trace of one battle: the events each side plans and executes, the damage
+// they do and the defender's random draws. The engines record into a ring of the calling
+// thread when built with BATTLE_TRACE, and the replay in trace.c always records, so any battle
+// of a sweep can be fought again with a trace in a release build
+
+#include "battle.h"
+#include "random.h"
+
+// Records kept by each thread (a power of 2); older ones are overwritten
+#define TRACE_RECORDS 8192
+#define TRACE_MASK (TRACE_RECORDS - 1)
+// Sides of a record
+#define TRACE_ATTACKER 0
+#define TRACE_DEFENDER 1
+// Kinds of records, with what their time and values hold
+// Battle set up: time 0, HP of the defender and 0
+#define RECORD_START 0
+// Planner called: time now, events planned and energy of the side afterwards
+#define RECORD_PLAN 1
+// Event planned: start time of the event, its duration and 0
+#define RECORD_QUEUE 2
+// Event executed: its start time, the damage done (after any dodge) and the foe's damage
+// taken so far
+#define RECORD_EXECUTE 3
+// Defender random draw: time now, the 16-bit value drawn and 0
+#define RECORD_DRAW 4
+// Defender attack executed while the attacker was dodging: as RECORD_EXECUTE
+#define RECORD_DODGED 5
+// Battle over: end time, the result of battleResult and 0
+#define RECORD_END 6
+
+typedef struct _TraceRecord {
+	// RECORD_x
+	uint8_t kind;
+	// TRACE_ATTACKER or TRACE_DEFENDER
+	uint8_t side;
+	// EVENT_x of the event, if any
+	uint16_t type;
+	// Battle time in ms
+	int time;
+	// Values that depend on the kind
+	int value;
+	int extra;
+} TraceRecord;
+
+typedef struct _TraceRing {
+	// Latest records, the next one at count & TRACE_MASK
+	TraceRecord records[TRACE_RECORDS];
+	// Records added since the ring was cleared
+	long long count;
+} TraceRing;
+
+// Which battle of which matchup a trace file holds
+typedef struct _TraceInfo {
+	// Sides of the matchup
+	Pokemon attacker;
+	Pokemon defender;
+	// STRAT_x the attacker planned by
+	int strategy;
+	// Battle number within the matchup, and the matchup's seed
+	int battle;
+	uint64_t seed;
+	// Result of battleResult
+	int result;
+} TraceInfo;
+
+#ifdef BATTLE_TRACE
+#include "platform.h"
+
+// Records of the calling thread
+extern THREAD_LOCAL TraceRing threadTrace;
+
+// Adds a record to the calling thread's ring
+static inline void traceAdd(int kind, int side, int type, int time, int value, int extra) {
+	TraceRecord *rec = &threadTrace.records[threadTrace.count++ & TRACE_MASK];
+	rec->kind = (uint8_t)kind;
+	rec->side = (uint8_t)side;
+	rec->type = (uint16_t)type;
+	rec->time = time;
+	rec->value = value;
+	rec->extra = extra;
+}
+
+// Adds a planner call and every event it planned (all the events left in the timeline, as
+// planners are only called once it is empty)
+static inline void tracePlanned(int side, const Timeline *tl, int now, int nrg) {
+	traceAdd(RECORD_PLAN, side, EVENT_NOP, now, tl->plan - tl->exec, nrg);
+	for (int i = tl->exec; i < tl->plan; i++) {
+		const FightEvent *evt = &tl->data[i & TIMELINE_MASK];
+		traceAdd(RECORD_QUEUE, side, evt->type, evt->time, evt->duration, 0);
+	}
+}
+
+// Adds a record
+#define TRACE_ADD(_kind, _side, _type, _time, _value, _extra) traceAdd((_kind), (_side), \
+	(_type), (_time), (_value), (_extra))
+// Adds a planner call and the events it planned
+#define TRACE_PLANNED(_side, _tl, _now, _nrg) tracePlanned((_side), (_tl), (_now), (_nrg))
+#else
+#define TRACE_ADD(_kind, _side, _type, _time, _value, _extra) ((void)0)
+#define TRACE_PLANNED(_side, _tl, _now, _nrg) ((void)0)
+#endif
+
+// Clears the calling thread's ring
+void clearTrace();
+// Fights battle number info->battle of the matchup (seeded with info->seed as repeatFight
+// seeds it) while recording it, and stores the result in the info
+void replayBattle(TraceInfo *info);
+// Writes the calling thread's ring and the battle it holds to a file; returns false if the
+// file could not be written
+bool writeTrace(const char *fileName, const TraceInfo *info);
+// Decodes a trace file and prints every record in it; returns false if the file is not a
+// valid trace
+bool printTrace(const char *fileName);